@@ -0,0 +1,145 @@
+// Offline benchmark av dsp-kedjan. Kör brus genom varje effekt för sig och
+// genom hela kedjan, och skriver ut kostnad per frame samt andel av
+// realtidsbudgeten.
+//
+//   ./build/apps/dsp_bench/dsp_bench [sekunder]
+
+#include "dsp/dc_blocker.h"
+#include "dsp/distortion.h"
+#include "dsp/effect.h"
+#include "dsp/effect_chain.h"
+#include "dsp/eq3band.h"
+#include "dsp/limiter.h"
+#include "dsp/multiband_dynamics.h"
+#include "dsp/reverb.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int sample_rate = 44100;
+constexpr int channels = 2;
+constexpr size_t block_frames = 1024;
+
+struct result {
+  std::string name;
+  double ns_per_frame = 0.0;
+};
+
+// Samma block återanvänds; signalen fylls på från en förgenererad brusbuffert
+// så att slumpgeneratorn inte hamnar i mätningen.
+double run(const std::function<void(float *, size_t)> &fn,
+           const std::vector<float> &noise, size_t total_frames) {
+  std::vector<float> buf(block_frames * channels);
+  const size_t noise_frames = noise.size() / channels;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (size_t done = 0; done < total_frames; done += block_frames) {
+    const size_t off = (done % noise_frames) * channels;
+    std::copy(noise.begin() + static_cast<std::ptrdiff_t>(off),
+              noise.begin() +
+                  static_cast<std::ptrdiff_t>(off + buf.size()),
+              buf.begin());
+    fn(buf.data(), block_frames);
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() /
+         static_cast<double>(total_frames);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  const size_t total_frames =
+      static_cast<size_t>(seconds * sample_rate) / block_frames * block_frames;
+
+  // Brus runt 0 dBFS så att limitern faktiskt arbetar
+  std::vector<float> noise(static_cast<size_t>(sample_rate) * channels +
+                           block_frames * channels);
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> dist(0.0f, 0.5f);
+  for (float &s : noise)
+    s = dist(rng);
+
+  auto bench = [&](const char *name, dsp::effect &fx) {
+    return result{name, run([&](float *b, size_t n) {
+                              fx.process(b, n, channels);
+                            },
+                            noise, total_frames)};
+  };
+
+  std::vector<result> results;
+
+  {
+    dsp::eq3band eq(sample_rate);
+    eq.set_low_db(10.0f);
+    results.push_back(bench("eq3band", eq));
+  }
+  {
+    dsp::multiband_dynamics mbc(sample_rate, channels);
+    results.push_back(bench("multiband (3 band)", mbc));
+  }
+  {
+    dsp::multiband_dynamics mbc(sample_rate, channels,
+                                {150.0f, 1500.0f, 6000.0f});
+    results.push_back(bench("multiband (4 band)", mbc));
+  }
+  {
+    dsp::reverb rv(sample_rate, 2000.0f, channels);
+    results.push_back(bench("reverb", rv));
+  }
+  {
+    dsp::distortion dist_fx;
+    results.push_back(bench("distortion", dist_fx));
+  }
+  {
+    dsp::dc_blocker dc;
+    results.push_back(bench("dc_blocker", dc));
+  }
+  {
+    dsp::limiter lim(sample_rate, channels);
+    lim.set_true_peak(false);
+    results.push_back(bench("limiter (sample peak)", lim));
+  }
+  {
+    dsp::limiter lim(sample_rate, channels);
+    results.push_back(bench("limiter (true peak)", lim));
+  }
+
+  {
+    dsp::EffectChain chain;
+    chain.add(std::make_unique<dsp::eq3band>(sample_rate));
+    chain.add(std::make_unique<dsp::multiband_dynamics>(sample_rate, channels));
+    chain.add(std::make_unique<dsp::reverb>(sample_rate, 2000.0f, channels));
+    chain.add(std::make_unique<dsp::distortion>());
+    chain.add(std::make_unique<dsp::dc_blocker>());
+    chain.add(std::make_unique<dsp::limiter>(sample_rate, channels));
+    results.push_back(result{"chain", run([&](float *b, size_t n) {
+                                            chain.process(b, n, channels);
+                                          },
+                                          noise, total_frames)});
+  }
+
+  const double budget_ns = 1e9 / sample_rate;
+  const double chain_ns = results.back().ns_per_frame;
+
+  const double eq_ns = results.front().ns_per_frame;
+
+  std::printf("%-24s %12s %12s %12s %10s\n", "effect", "ns/frame",
+              "% realtime", "% of chain", "x eq3band");
+  for (const auto &r : results) {
+    std::printf("%-24s %12.2f %12.3f %12.1f %10.2f\n", r.name.c_str(),
+                r.ns_per_frame, 100.0 * r.ns_per_frame / budget_ns,
+                100.0 * r.ns_per_frame / chain_ns, r.ns_per_frame / eq_ns);
+  }
+  return 0;
+}
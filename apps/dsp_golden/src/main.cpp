@@ -0,0 +1,559 @@
+// Golden-test för dsp-kedjan: kör deterministiska signaler genom både de
+// skalära referenserna (reference.h) och produktionskoden, med många
+// blockstorlekar och kanalantal, och jämför. Tänkt att köras före och efter
+// varje optimering i libs/dsp.
+//
+//   ./build/apps/dsp_golden/dsp_golden [filter] [--exact] [--ieee]
+//                                      [--dump katalog]
+//
+// filter väljer fall vars namn innehåller texten. --exact kräver bitexakt
+// utgång i stället för toleransen. Som standard körs allt med FTZ/DAZ som
+// i ljudtrådarna; --ieee behåller denormalerna (långsamt, men visar om en
+// snabb variant hanterar dem annorlunda). Vid fel skrivs avvikande sampel
+// som CSV till katalogen (standard "."), och programmet avslutas med 1.
+
+#include "reference.h"
+
+#include "audio/realtime.h"
+#include "audio/sample_format.h"
+
+#include "dsp/crossover.h"
+#include "dsp/dc_blocker.h"
+#include "dsp/distortion.h"
+#include "dsp/eq3band.h"
+#include "dsp/gain.h"
+#include "dsp/limiter.h"
+#include "dsp/mixer.h"
+#include "dsp/multiband_dynamics.h"
+#include "dsp/reverb.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int sample_rate = 44100;
+
+// Blockstorlek 0 => varierande storlekar ur en fast sekvens
+constexpr size_t block_sizes[] = {1, 3, 16, 64, 100, 256, 1024, 4096, 0};
+constexpr int channel_counts[] = {1, 2, 3, 6, 8};
+constexpr size_t max_block = 4096;
+
+// En bearbetning från in till out, båda interleavade. out rymmer
+// frames * out_channels(ch).
+struct kernel {
+  virtual ~kernel() = default;
+  virtual int out_channels(int ch) const { return ch; }
+  virtual void process(const float *in, float *out, size_t frames,
+                       int ch) = 0;
+};
+
+// Effekter som bearbetar bufferten på plats: dsp::* och golden::*
+template <typename E> struct effect_kernel final : kernel {
+  template <typename... A> explicit effect_kernel(A &&...a) : fx(a...) {}
+  void process(const float *in, float *out, size_t frames, int ch) override {
+    std::copy(in, in + frames * static_cast<size_t>(ch), out);
+    fx.process(out, frames, ch);
+  }
+  E fx;
+};
+
+template <typename X> struct crossover_kernel final : kernel {
+  template <typename... A> explicit crossover_kernel(A &&...a) : fx(a...) {}
+  int out_channels(int ch) const override {
+    return static_cast<int>(fx.output_channels(ch));
+  }
+  void process(const float *in, float *out, size_t frames, int ch) override {
+    fx.process(in, out, frames, ch);
+  }
+  X fx;
+};
+
+// Ingång 0 är testsignalen (prioritet 0). Ingång 1 är tonskurar med hög
+// prioritet som duckar den, med ofullständiga block då och då. Ingång 2
+// läggs till och tas bort under körningen.
+template <typename M> struct mixer_kernel final : kernel {
+  explicit mixer_kernel(int ch)
+      : fx(sample_rate, ch, max_block), channels(ch) {
+    const size_t len = static_cast<size_t>(sample_rate) * 2;
+    bursts.resize(len * static_cast<size_t>(ch));
+    for (size_t f = 0; f < len; ++f) {
+      const bool on = (f / 8000) % 3 == 1;
+      for (int c = 0; c < ch; ++c)
+        bursts[f * static_cast<size_t>(ch) + static_cast<size_t>(c)] =
+            on ? 0.4f * std::sin(0.07f * static_cast<float>(f) +
+                                 static_cast<float>(c))
+               : 0.0f;
+    }
+  }
+
+  void process(const float *in, float *out, size_t frames, int) override {
+    const size_t ch = static_cast<size_t>(channels);
+    const size_t len = bursts.size() / ch;
+    typename M::input inputs[M::max_inputs];
+
+    inputs[0].interleaved = in;
+    inputs[0].frames = frames;
+
+    // bursts läses i bitar som får plats före slutet
+    const size_t at = pos % len;
+    inputs[1].interleaved = &bursts[at * ch];
+    inputs[1].frames =
+        std::min(block % 7 == 3 ? frames / 2 : frames, len - at);
+    inputs[1].priority = 10;
+    inputs[1].gain_db = -3.0f;
+
+    if (block % 40 >= 10 && block % 40 < 30) {
+      inputs[2].interleaved = in;
+      inputs[2].frames = frames;
+      inputs[2].priority = 5;
+      inputs[2].duck_db = -6.0f;
+      inputs[2].gain_db = -12.0f;
+      inputs[2].restart = block % 40 == 10;
+    }
+
+    fx.process(inputs, out, frames);
+    pos += frames;
+    ++block;
+  }
+
+  M fx;
+  int channels;
+  std::vector<float> bursts;
+  size_t pos = 0;
+  size_t block = 0;
+};
+
+struct test_case {
+  std::string name;
+  float max_abs;     // största tillåtna avvikelse
+  double min_snr_db; // minsta signal/avvikelse
+  bool strided;      // testa även en extra kanal som ska lämnas orörd
+  std::function<std::unique_ptr<kernel>(bool reference, int ch)> make;
+};
+
+enum class signal_kind { impulse, sweep, noise, denormal };
+
+const char *to_string(signal_kind k) {
+  switch (k) {
+  case signal_kind::impulse:
+    return "impulse";
+  case signal_kind::sweep:
+    return "sweep";
+  case signal_kind::noise:
+    return "noise";
+  case signal_kind::denormal:
+    return "denormal";
+  }
+  return "?";
+}
+
+// Olika innehåll per kanal, så att förväxlade kanaler syns.
+std::vector<float> make_signal(signal_kind k, int ch) {
+  const size_t frames = static_cast<size_t>(sample_rate) * 6 / 10;
+  const size_t n = frames * static_cast<size_t>(ch);
+  std::vector<float> s(n, 0.0f);
+  std::mt19937 rng(777);
+
+  for (int c = 0; c < ch; ++c) {
+    auto at = [&](size_t f) -> float & {
+      return s[f * static_cast<size_t>(ch) + static_cast<size_t>(c)];
+    };
+    switch (k) {
+    case signal_kind::impulse:
+      // impulser med olika höjd, tätare än reverbens fördröjning
+      for (size_t f = static_cast<size_t>(c) * 3; f < frames; f += 4410)
+        at(f) = c % 2 ? -0.9f : 1.0f;
+      break;
+    case signal_kind::sweep: {
+      // logaritmiskt svep 20 Hz - 20 kHz, toppar över taket för limitern
+      const double t1 = static_cast<double>(frames) / sample_rate;
+      const double k_ = std::log(1000.0);
+      for (size_t f = 0; f < frames; ++f) {
+        const double t = static_cast<double>(f) / sample_rate;
+        const double ph =
+            2.0 * M_PI * 20.0 * t1 / k_ * (std::exp(t / t1 * k_) - 1.0);
+        at(f) = static_cast<float>(1.2 * std::sin(ph + c));
+      }
+      break;
+    }
+    case signal_kind::noise: {
+      std::normal_distribution<float> dist(0.0f, 0.5f);
+      for (size_t f = 0; f < frames; ++f)
+        at(f) = dist(rng);
+      break;
+    }
+    case signal_kind::denormal: {
+      // kort skur, sedan tystnad där filterminnen klingar av mot denormaler,
+      // plus några denormala insampel
+      std::uniform_real_distribution<float> dist(-0.8f, 0.8f);
+      for (size_t f = 0; f < 2000; ++f)
+        at(f) = dist(rng);
+      for (size_t f = 20000; f < frames; f += 5001)
+        at(f) = (c % 2 ? -1.0f : 1.0f) * std::numeric_limits<float>::denorm_min() *
+                static_cast<float>(1 + f % 1000);
+      break;
+    }
+    }
+  }
+  return s;
+}
+
+// Blockstorlekar för "varierande": fast pseudoslumpsekvens 1..2048
+std::vector<size_t> block_plan(size_t block, size_t frames) {
+  std::vector<size_t> plan;
+  uint32_t lcg = 12345;
+  for (size_t done = 0; done < frames;) {
+    size_t n = block;
+    if (block == 0) {
+      lcg = lcg * 1664525u + 1013904223u;
+      n = 1 + (lcg >> 8) % 2048;
+    }
+    n = std::min(n, frames - done);
+    plan.push_back(n);
+    done += n;
+  }
+  return plan;
+}
+
+std::vector<float> render(kernel &k, const std::vector<float> &in, int ch,
+                          const std::vector<size_t> &plan) {
+  const size_t out_ch = static_cast<size_t>(k.out_channels(ch));
+  const size_t frames = in.size() / static_cast<size_t>(ch);
+  std::vector<float> out(frames * out_ch);
+  size_t done = 0;
+  for (size_t n : plan) {
+    k.process(&in[done * static_cast<size_t>(ch)], &out[done * out_ch], n, ch);
+    done += n;
+  }
+  return out;
+}
+
+struct compare_result {
+  float max_abs = 0.0f;
+  double snr_db = std::numeric_limits<double>::infinity();
+  size_t first_diff = std::numeric_limits<size_t>::max();
+};
+
+compare_result compare(const std::vector<float> &ref,
+                       const std::vector<float> &out) {
+  compare_result r;
+  double sig = 0.0, err = 0.0;
+  for (size_t i = 0; i < ref.size(); ++i) {
+    const float d = std::fabs(out[i] - ref[i]);
+    // NaN ska aldrig räknas som lika
+    if (d > r.max_abs || d != d)
+      r.max_abs = d != d ? std::numeric_limits<float>::infinity() : d;
+    if (out[i] != ref[i] && r.first_diff == std::numeric_limits<size_t>::max())
+      r.first_diff = i;
+    sig += static_cast<double>(ref[i]) * ref[i];
+    err += static_cast<double>(d) * d;
+  }
+  if (err > 0.0)
+    r.snr_db = 10.0 * std::log10(std::max(sig, 1e-300) / err);
+  return r;
+}
+
+void dump(const std::string &dir, const std::string &id,
+          const std::vector<float> &ref, const std::vector<float> &out,
+          int out_ch, float max_abs) {
+  const std::string path = dir + "/" + id + ".csv";
+  FILE *f = std::fopen(path.c_str(), "w");
+  if (!f) {
+    std::perror(path.c_str());
+    return;
+  }
+  std::fprintf(f, "frame,channel,reference,optimized,diff\n");
+  size_t lines = 0;
+  for (size_t i = 0; i < ref.size() && lines < 10000; ++i) {
+    const float d = out[i] - ref[i];
+    if (!(std::fabs(d) <= max_abs)) {
+      std::fprintf(f, "%zu,%zu,%.9g,%.9g,%.9g\n", i / out_ch, i % out_ch,
+                   ref[i], out[i], d);
+      ++lines;
+    }
+  }
+  std::fclose(f);
+  std::printf("    diff: %s\n", path.c_str());
+}
+
+template <typename E, typename Setup, typename... A>
+std::unique_ptr<kernel> make_effect(Setup setup, A... a) {
+  auto k = std::make_unique<effect_kernel<E>>(a...);
+  setup(k->fx);
+  return k;
+}
+
+std::vector<test_case> make_cases() {
+  std::vector<test_case> cases;
+
+  cases.push_back({"gain", 0.0f, 200.0, true, [](bool ref, int) {
+                     auto setup = [](auto &fx) { fx.set_db(-7.5f); };
+                     if (ref)
+                       return make_effect<golden::gain>(setup);
+                     // dsp::gain är per sample, inte en effect
+                     struct gain_fx {
+                       dsp::gain g;
+                       void set_db(float db) { g.set_db(db); }
+                       void process(float *b, size_t frames, int ch) {
+                         for (size_t i = 0; i < frames * static_cast<size_t>(ch);
+                              ++i)
+                           b[i] = g.process(b[i]);
+                       }
+                     };
+                     return make_effect<gain_fx>(setup);
+                   }});
+
+  cases.push_back({"distortion", 0.0f, 200.0, true, [](bool ref, int) {
+                     auto setup = [](auto &) {};
+                     if (ref)
+                       return make_effect<golden::distortion>(setup);
+                     return make_effect<dsp::distortion>(setup);
+                   }});
+
+  cases.push_back({"dc_blocker", 1e-6f, 120.0, true, [](bool ref, int ch) {
+                     auto setup = [](auto &) {};
+                     if (ref)
+                       return make_effect<golden::dc_blocker>(setup, 10.0, ch,
+                                                              sample_rate);
+                     return make_effect<dsp::dc_blocker>(setup, 10.0, ch);
+                   }});
+
+  cases.push_back({"eq3band", 1e-5f, 110.0, true, [](bool ref, int ch) {
+                     auto setup = [](auto &fx) {
+                       fx.set_low_db(10.0f);
+                       fx.set_mid_db(-4.0f);
+                       fx.set_high_db(3.0f);
+                     };
+                     if (ref)
+                       return make_effect<golden::eq3band>(
+                           setup, static_cast<float>(sample_rate), ch);
+                     return make_effect<dsp::eq3band>(
+                         setup, static_cast<float>(sample_rate), ch);
+                   }});
+
+  // 2.71 ms ligger mellan två sampel och går genom interpolationen
+  for (const auto &[name, delay_ms] :
+       {std::pair<const char *, float>{"reverb_120ms", 120.0f},
+        {"reverb_3ms", 3.0f},
+        {"reverb_fractional", 2.71f}}) {
+    cases.push_back(
+        {name, 1e-6f, 120.0, true, [delay_ms](bool ref, int ch) {
+           auto setup = [delay_ms](auto &fx) {
+             fx.setDelayMs(delay_ms);
+             fx.setFeedback(0.6f);
+           };
+           if (ref)
+             return make_effect<golden::reverb>(setup, sample_rate, 500.0f,
+                                                ch);
+           return make_effect<dsp::reverb>(setup, sample_rate, 500.0f, ch);
+         }});
+  }
+
+  for (const bool tp : {false, true}) {
+    cases.push_back(
+        {tp ? "limiter_true_peak" : "limiter_sample_peak", 1e-6f, 120.0, true,
+         [tp](bool ref, int ch) {
+           auto setup = [tp](auto &fx) {
+             fx.set_ceiling_db(-3.0f);
+             fx.set_lookahead_ms(1.5f);
+             fx.set_release_ms(40.0f);
+             fx.set_true_peak(tp);
+           };
+           if (ref)
+             return make_effect<golden::limiter>(setup, sample_rate, ch);
+           return make_effect<dsp::limiter>(setup, sample_rate, ch);
+         }});
+  }
+
+  for (const int order : {4, 8}) {
+    cases.push_back(
+        {"crossover_lr" + std::to_string(order), 1e-5f, 110.0, false,
+         [order](bool ref, int ch) -> std::unique_ptr<kernel> {
+           auto setup = [](auto &fx) {
+             fx.set_frequencies({150.0f, 1200.0f, 6000.0f});
+             fx.set_gain_db(1, -3.0f);
+             fx.set_delay_ms(0, 0.5f);
+             fx.set_inverted(2, true);
+           };
+           const float rate = static_cast<float>(sample_rate);
+           if (ref) {
+             auto k = std::make_unique<crossover_kernel<golden::crossover>>(
+                 rate, ch, order);
+             setup(k->fx);
+             return k;
+           }
+           auto k = std::make_unique<crossover_kernel<dsp::crossover>>(
+               rate, ch, order);
+           setup(k->fx);
+           return k;
+         }});
+  }
+
+  // fast_log2/fast_exp2 delas med referensen; det är blockstrukturen och
+  // banorna som testas här
+  cases.push_back({"multiband_dynamics", 1e-5f, 110.0, true,
+                   [](bool ref, int ch) {
+                     auto setup = [](auto &) {};
+                     const float rate = static_cast<float>(sample_rate);
+                     const std::vector<float> split = {200.0f, 2500.0f};
+                     if (ref)
+                       return make_effect<golden::multiband_dynamics>(
+                           setup, rate, ch, split);
+                     return make_effect<dsp::multiband_dynamics>(setup, rate,
+                                                                 ch, split);
+                   }});
+
+  cases.push_back({"mixer", 1e-6f, 120.0, false,
+                   [](bool ref, int ch) -> std::unique_ptr<kernel> {
+                     if (ref)
+                       return std::make_unique<mixer_kernel<golden::mixer>>(ch);
+                     return std::make_unique<mixer_kernel<dsp::mixer>>(ch);
+                   }});
+
+  return cases;
+}
+
+// Konverteringsloopen i audio::to_float mot referensen, alla heltalsformat,
+// slumpade byte.
+bool check_conversions() {
+  struct fmt {
+    audio::sample_format f;
+    size_t bytes;
+    float (*ref)(const uint8_t *);
+  };
+  const fmt formats[] = {
+      {audio::sample_format::s16, 2, golden::s16_to_float},
+      {audio::sample_format::s24, 4, golden::s24_to_float},
+      {audio::sample_format::s24_3, 3, golden::s24_to_float},
+      {audio::sample_format::s32, 4, golden::s32_to_float},
+  };
+
+  std::mt19937 rng(99);
+  bool ok = true;
+  for (const fmt &f : formats) {
+    for (const size_t n : {1u, 7u, 64u, 4099u}) {
+      std::vector<uint8_t> raw(n * f.bytes + 1);
+      for (uint8_t &b : raw)
+        b = static_cast<uint8_t>(rng());
+      // +1: osjusterad buffert som efter fread
+      std::vector<float> out(n);
+      audio::to_float(raw.data() + 1, out.data(), n, f.f);
+      for (size_t i = 0; i < n; ++i) {
+        const float r = f.ref(raw.data() + 1 + i * f.bytes);
+        if (out[i] != r) {
+          std::printf("FAIL to_float %s n=%zu sample %zu: %.9g != %.9g\n",
+                      audio::to_string(f.f), n, i, out[i], r);
+          ok = false;
+          break;
+        }
+      }
+    }
+  }
+  if (ok)
+    std::printf("ok   to_float (S16, S24, S24_3, S32)\n");
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string filter;
+  std::string dump_dir = ".";
+  bool exact = false;
+  bool ieee = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--exact")
+      exact = true;
+    else if (a == "--ieee")
+      ieee = true;
+    else if (a == "--dump" && i + 1 < argc)
+      dump_dir = argv[++i];
+    else
+      filter = a;
+  }
+
+  if (!ieee)
+    audio::flush_denormals();
+
+  const signal_kind signals[] = {signal_kind::impulse, signal_kind::sweep,
+                                 signal_kind::noise, signal_kind::denormal};
+
+  bool ok = true;
+  if (filter.empty() || std::string("to_float").find(filter) == 0)
+    ok = check_conversions();
+
+  for (const test_case &tc : make_cases()) {
+    if (!filter.empty() && tc.name.find(filter) == std::string::npos)
+      continue;
+
+    size_t runs = 0, bit_exact = 0, failures = 0;
+    float worst = 0.0f;
+    double worst_snr = std::numeric_limits<double>::infinity();
+
+    for (const int ch : channel_counts) {
+      // strided: bufferten har en kanal till än effekten är förberedd för
+      for (const int extra : {0, 1}) {
+        if (extra && !tc.strided)
+          continue;
+        const int buf_ch = ch + extra;
+
+        for (const signal_kind sk : signals) {
+          const std::vector<float> in = make_signal(sk, buf_ch);
+          const size_t frames = in.size() / static_cast<size_t>(buf_ch);
+
+          for (const size_t bs : block_sizes) {
+            const std::vector<size_t> plan = block_plan(bs, frames);
+            auto ref_k = tc.make(true, ch);
+            auto opt_k = tc.make(false, ch);
+            const std::vector<float> ref = render(*ref_k, in, buf_ch, plan);
+            const std::vector<float> out = render(*opt_k, in, buf_ch, plan);
+            const compare_result r = compare(ref, out);
+
+            ++runs;
+            if (r.first_diff == std::numeric_limits<size_t>::max())
+              ++bit_exact;
+            worst = std::max(worst, r.max_abs);
+            worst_snr = std::min(worst_snr, r.snr_db);
+
+            const bool pass =
+                exact ? r.first_diff == std::numeric_limits<size_t>::max()
+                      : r.max_abs <= tc.max_abs && r.snr_db >= tc.min_snr_db;
+            if (pass)
+              continue;
+
+            ++failures;
+            ok = false;
+            const int out_ch = ref_k->out_channels(buf_ch);
+            const std::string id =
+                tc.name + "_" + to_string(sk) + "_b" +
+                (bs ? std::to_string(bs) : std::string("var")) + "_ch" +
+                std::to_string(ch) + (extra ? "+1" : "");
+            std::printf("FAIL %s: max_abs %.3g, snr %.1f dB, first diff at "
+                        "frame %zu ch %zu\n",
+                        id.c_str(), r.max_abs, r.snr_db,
+                        r.first_diff / static_cast<size_t>(out_ch),
+                        r.first_diff % static_cast<size_t>(out_ch));
+            dump(dump_dir, id, ref, out, out_ch, exact ? 0.0f : tc.max_abs);
+          }
+        }
+      }
+    }
+
+    std::printf("%-4s %-22s %4zu runs, %4zu bit-exact, max_abs %.3g, "
+                "min snr %.1f dB\n",
+                failures ? "FAIL" : "ok", tc.name.c_str(), runs, bit_exact,
+                worst, worst_snr);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,711 @@
+#pragma once
+
+// Skalära referenser för dsp-effekterna.
+//
+// Samma matematik som produktionskoden, i samma ordning per sample, men
+// utan specialiserade kanalloopar, lokala tillståndskopior, maskade
+// ringbuffertar eller planära block: en kanal och ett sample i taget, med
+// hela historiken i vanliga vektorer. Här ska inget optimeras; det är
+// facit som de snabba varianterna jämförs mot.
+
+#include "dsp/fast_math.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace golden {
+
+class gain {
+public:
+  void set_db(float db) {
+    db_ = std::clamp(db, -80.0f, 12.0f);
+    linear_ = std::pow(10.0f, db_ / 20.0f);
+  }
+
+  void process(float *buf, size_t frames, int ch) {
+    for (size_t i = 0; i < frames * static_cast<size_t>(ch); ++i)
+      buf[i] = buf[i] * linear_;
+  }
+
+private:
+  float db_ = 0.0f;
+  float linear_ = 1.0f;
+};
+
+// distortion::process har kanalloopen "for (c = 0; ch < c; ch++)", som
+// aldrig körs: effekten ändrar inget. Referensen speglar det tills loopen
+// rättas, och då ska referensen bli tanh-blandningen.
+class distortion {
+public:
+  void process(float *, size_t, int) {}
+};
+
+class dc_blocker {
+public:
+  dc_blocker(double hz, int max_channels, int sample_rate)
+      : max_channels_(max_channels),
+        r_(static_cast<float>(std::exp(-2.0 * M_PI * hz / sample_rate))),
+        x_prev_(static_cast<size_t>(max_channels)),
+        y_prev_(static_cast<size_t>(max_channels)) {}
+
+  void process(float *buf, size_t frames, int ch) {
+    const int cn = std::min(ch, max_channels_);
+    for (int c = 0; c < cn; ++c) {
+      for (size_t f = 0; f < frames; ++f) {
+        float &s = buf[f * static_cast<size_t>(ch) + static_cast<size_t>(c)];
+        const float y = s - x_prev_[c] + r_ * y_prev_[c];
+        x_prev_[c] = s;
+        y_prev_[c] = y;
+        s = y;
+      }
+    }
+  }
+
+private:
+  int max_channels_;
+  float r_;
+  std::vector<float> x_prev_, y_prev_;
+};
+
+// Biquad i transponerad direktform II, en kanal.
+struct biquad {
+  float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+
+  void set_normalized(float b0n, float b1n, float b2n, float a0n, float a1n,
+                      float a2n) {
+    b0 = b0n / a0n;
+    b1 = b1n / a0n;
+    b2 = b2n / a0n;
+    a1 = a1n / a0n;
+    a2 = a2n / a0n;
+  }
+
+  float run(float x, float &z1, float &z2) const {
+    const float y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+class eq3band {
+public:
+  eq3band(float sample_rate, int max_channels)
+      : sample_rate_(sample_rate), max_channels_(max_channels),
+        z_(static_cast<size_t>(max_channels)) {
+    update();
+  }
+
+  void set_low_db(float db) {
+    low_db_ = std::clamp(db, -12.0f, 12.0f);
+    update();
+  }
+  void set_mid_db(float db) {
+    mid_db_ = std::clamp(db, -12.0f, 12.0f);
+    update();
+  }
+  void set_high_db(float db) {
+    high_db_ = std::clamp(db, -12.0f, 12.0f);
+    update();
+  }
+
+  void process(float *buf, size_t frames, int ch) {
+    const int cn = std::min(ch, max_channels_);
+    for (int c = 0; c < cn; ++c) {
+      state &z = z_[static_cast<size_t>(c)];
+      for (size_t f = 0; f < frames; ++f) {
+        float &s = buf[f * static_cast<size_t>(ch) + static_cast<size_t>(c)];
+        float x = s;
+        for (int k = 0; k < 3; ++k)
+          x = sections_[k].run(x, z.z1[k], z.z2[k]);
+        s = x;
+      }
+    }
+  }
+
+private:
+  struct state {
+    float z1[3]{}, z2[3]{};
+  };
+
+  void update() {
+    const float pi = static_cast<float>(M_PI);
+
+    // low shelf 120 Hz
+    {
+      const float a = std::pow(10.0f, low_db_ / 40.0f);
+      const float w0 = 2.0f * pi * 120.0f / sample_rate_;
+      const float cw = std::cos(w0);
+      const float alpha = std::sin(w0) * std::sqrt(2.0f) * 0.5f;
+      const float sa = std::sqrt(a);
+      sections_[0].set_normalized(
+          a * ((a + 1.0f) - (a - 1.0f) * cw + 2.0f * sa * alpha),
+          2.0f * a * ((a - 1.0f) - (a + 1.0f) * cw),
+          a * ((a + 1.0f) - (a - 1.0f) * cw - 2.0f * sa * alpha),
+          (a + 1.0f) + (a - 1.0f) * cw + 2.0f * sa * alpha,
+          -2.0f * ((a - 1.0f) + (a + 1.0f) * cw),
+          (a + 1.0f) + (a - 1.0f) * cw - 2.0f * sa * alpha);
+    }
+    // peaking 1 kHz, Q 0.9
+    {
+      const float a = std::pow(10.0f, mid_db_ / 40.0f);
+      const float w0 = 2.0f * pi * 1000.0f / sample_rate_;
+      const float cw = std::cos(w0);
+      const float alpha = std::sin(w0) / (2.0f * 0.9f);
+      sections_[1].set_normalized(1.0f + alpha * a, -2.0f * cw,
+                                  1.0f - alpha * a, 1.0f + alpha / a,
+                                  -2.0f * cw, 1.0f - alpha / a);
+    }
+    // high shelf 8 kHz
+    {
+      const float a = std::pow(10.0f, high_db_ / 40.0f);
+      const float w0 = 2.0f * pi * 8000.0f / sample_rate_;
+      const float cw = std::cos(w0);
+      const float alpha = std::sin(w0) * std::sqrt(2.0f) * 0.5f;
+      const float sa = std::sqrt(a);
+      sections_[2].set_normalized(
+          a * ((a + 1.0f) + (a - 1.0f) * cw + 2.0f * sa * alpha),
+          -2.0f * a * ((a - 1.0f) + (a + 1.0f) * cw),
+          a * ((a + 1.0f) + (a - 1.0f) * cw - 2.0f * sa * alpha),
+          (a + 1.0f) - (a - 1.0f) * cw + 2.0f * sa * alpha,
+          2.0f * ((a - 1.0f) - (a + 1.0f) * cw),
+          (a + 1.0f) - (a - 1.0f) * cw - 2.0f * sa * alpha);
+    }
+  }
+
+  float sample_rate_;
+  int max_channels_;
+  float low_db_ = 0.0f, mid_db_ = 0.0f, high_db_ = 0.0f;
+  biquad sections_[3];
+  std::vector<state> z_;
+};
+
+// Feedback-eko med linjärt interpolerad fördröjning, minst ett sampel.
+// Fördröjningen hålls konstant inom ett fall, så reverbens glidning mot ett
+// nytt värde ingår inte.
+class reverb {
+public:
+  reverb(int sample_rate, float max_delay_ms, int max_channels)
+      : sample_rate_(sample_rate), max_channels_(max_channels),
+        max_delay_(std::max<size_t>(
+            1, static_cast<size_t>((max_delay_ms * 0.001f) *
+                                   static_cast<float>(sample_rate)))),
+        fed_(static_cast<size_t>(max_channels)) {}
+
+  void setDelayMs(float ms) { delay_ms_ = ms; }
+  void setFeedback(float fb) { fb_ = fb; }
+  void setWet(float wet) { wet_ = wet; }
+  void setDry(float dry) { dry_ = dry; }
+
+  void process(float *buf, size_t frames, int ch) {
+    const float max_ms = (static_cast<float>(max_delay_) /
+                          static_cast<float>(sample_rate_)) *
+                         1000.0f;
+    const float delay_ms = std::clamp(delay_ms_, 0.0f, max_ms);
+    const float fb = std::clamp(fb_, 0.0f, 0.98f);
+    const float wet = std::clamp(wet_, 0.0f, 1.0f);
+    const float dry = std::clamp(dry_, 0.0f, 2.0f);
+    const float d = std::clamp((delay_ms * 0.001f) *
+                                   static_cast<float>(sample_rate_),
+                               1.0f, static_cast<float>(max_delay_));
+    const size_t di = static_cast<size_t>(std::floor(d));
+    const float frac = d - static_cast<float>(di);
+
+    const int cn = std::min(ch, max_channels_);
+    for (int c = 0; c < cn; ++c) {
+      std::vector<float> &hist = fed_[static_cast<size_t>(c)];
+      for (size_t f = 0; f < frames; ++f) {
+        float &s = buf[f * static_cast<size_t>(ch) + static_cast<size_t>(c)];
+        const float x = s;
+        const size_t n = hist.size();
+        const float newer = n >= di ? hist[n - di] : 0.0f;
+        const float older = n >= di + 1 ? hist[n - di - 1] : 0.0f;
+        const float delayed = newer + frac * (older - newer);
+        hist.push_back(x + delayed * fb);
+        s = dry * x + wet * delayed;
+      }
+    }
+  }
+
+private:
+  int sample_rate_;
+  int max_channels_;
+  size_t max_delay_;
+  float delay_ms_ = 120.0f, fb_ = 0.25f, wet_ = 0.55f, dry_ = 0.8f;
+  std::vector<std::vector<float>> fed_;
+};
+
+// Look-ahead-limiter. Glidande minimum tas genom att söka igenom fönstret,
+// boxfiltret summeras löpande i double som i limiter::run (summan ingår i
+// algoritmen, avrundningen också).
+class limiter {
+public:
+  limiter(int sample_rate, int max_channels)
+      : sample_rate_(sample_rate), max_channels_(max_channels),
+        input_(static_cast<size_t>(max_channels)) {
+    design_true_peak_filter();
+  }
+
+  void set_ceiling_db(float db) { ceiling_db_ = std::clamp(db, -24.0f, 0.0f); }
+  void set_lookahead_ms(float ms) { lookahead_ms_ = std::clamp(ms, 1.0f, 5.0f); }
+  void set_release_ms(float ms) { release_ms_ = std::clamp(ms, 1.0f, 1000.0f); }
+  void set_true_peak(bool on) { true_peak_ = on; }
+
+  void process(float *buf, size_t frames, int ch) {
+    const size_t L = std::max<size_t>(
+        1, static_cast<size_t>(lookahead_ms_ * 0.001f *
+                                   static_cast<float>(sample_rate_) +
+                               0.5f));
+    if (!started_) {
+      started_ = true;
+      box_sum_ = static_cast<double>(L);
+    }
+    const size_t delay = L + (true_peak_ ? tp_delay : 0);
+    const float ceiling = std::pow(10.0f, ceiling_db_ / 20.0f);
+    const float release = std::exp(
+        -1.0f / (0.001f * release_ms_ * static_cast<float>(sample_rate_)));
+    const int cn = std::min(ch, max_channels_);
+
+    for (size_t f = 0; f < frames; ++f) {
+      float *frame = buf + f * static_cast<size_t>(ch);
+
+      float peak = 0.0f;
+      for (int c = 0; c < cn; ++c) {
+        input_[static_cast<size_t>(c)].push_back(frame[c]);
+        peak = std::max(peak, true_peak_ ? true_peak(c) : std::fabs(frame[c]));
+      }
+      g_req_.push_back(peak > ceiling ? ceiling / peak : 1.0f);
+
+      const size_t n = g_req_.size() - 1;
+      float g_min = 1.0f;
+      for (size_t i = n >= L ? n - L : 0; i <= n; ++i)
+        g_min = std::min(g_min, g_req_[i]);
+
+      const float oldest = n >= L ? g_min_hist_[n - L] : 1.0f;
+      g_min_hist_.push_back(g_min);
+      box_sum_ += static_cast<double>(g_min) - static_cast<double>(oldest);
+      const float g_box =
+          static_cast<float>(box_sum_ * (1.0 / static_cast<double>(L)));
+
+      if (g_box < env_)
+        env_ = g_box;
+      else
+        env_ = g_box + release * (env_ - g_box);
+      const float g = std::min(env_, n >= L ? g_req_[n - L] : 1.0f);
+
+      for (int c = 0; c < cn; ++c) {
+        const std::vector<float> &in = input_[static_cast<size_t>(c)];
+        frame[c] = (n >= delay ? in[n - delay] : 0.0f) * g;
+      }
+    }
+  }
+
+private:
+  static constexpr int tp_phases = 4;
+  static constexpr int tp_taps = 8;
+  static constexpr size_t tp_delay = tp_taps / 2;
+
+  void design_true_peak_filter() {
+    for (int p = 1; p < tp_phases; ++p) {
+      const double frac = static_cast<double>(p) / tp_phases;
+      double sum = 0.0;
+      double h[tp_taps];
+      for (int j = 0; j < tp_taps; ++j) {
+        const double t = static_cast<double>(static_cast<int>(tp_delay) - j) -
+                         frac;
+        const double sinc = t == 0.0 ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+        const double win =
+            0.5 + 0.5 * std::cos(M_PI * t / static_cast<double>(tp_delay));
+        h[j] = sinc * win;
+        sum += h[j];
+      }
+      for (int j = 0; j < tp_taps; ++j)
+        coef_[p - 1][tp_taps - 1 - j] = static_cast<float>(h[j] / sum);
+    }
+  }
+
+  // De senaste tp_taps samplen, äldst först, nollor före start.
+  float true_peak(int c) {
+    const std::vector<float> &in = input_[static_cast<size_t>(c)];
+    float win[tp_taps];
+    for (int k = 0; k < tp_taps; ++k) {
+      const size_t back = static_cast<size_t>(tp_taps - 1 - k);
+      win[k] = in.size() > back ? in[in.size() - 1 - back] : 0.0f;
+    }
+    float peak = std::fabs(win[tp_taps - 1 - tp_delay]);
+    for (int p = 0; p < tp_phases - 1; ++p) {
+      float y = 0.0f;
+      for (int k = 0; k < tp_taps; ++k)
+        y += coef_[p][k] * win[k];
+      peak = std::max(peak, std::fabs(y));
+    }
+    return peak;
+  }
+
+  int sample_rate_;
+  int max_channels_;
+  float ceiling_db_ = -1.0f, lookahead_ms_ = 2.0f, release_ms_ = 80.0f;
+  bool true_peak_ = true;
+  bool started_ = false;
+
+  std::vector<std::vector<float>> input_;
+  std::vector<float> g_req_;
+  std::vector<float> g_min_hist_;
+  double box_sum_ = 0.0;
+  float env_ = 1.0f;
+  float coef_[tp_phases - 1][tp_taps]{};
+};
+
+// Linkwitz-Riley-delning, en väg och en kanal i taget.
+class crossover {
+public:
+  static constexpr int max_ways = 4;
+
+  crossover(float sample_rate, int max_channels, int order)
+      : sample_rate_(sample_rate), max_channels_(max_channels),
+        sections_(order >= 8 ? 4 : 2) {
+    gain_.fill(1.0f);
+    delay_.fill(0);
+    invert_.fill(false);
+    set_frequencies({120.0f});
+  }
+
+  int ways() const { return ways_; }
+
+  size_t output_channels(int in_channels) const {
+    return static_cast<size_t>(std::min(in_channels, max_channels_)) *
+           static_cast<size_t>(ways_);
+  }
+
+  void set_frequencies(const std::vector<float> &hz) {
+    const int n = std::clamp(static_cast<int>(hz.size()), 1, max_ways - 1);
+    std::vector<float> f(static_cast<size_t>(n));
+    for (int j = 0; j < n; ++j)
+      f[static_cast<size_t>(j)] =
+          std::clamp(hz[static_cast<size_t>(j)], 20.0f, 0.45f * sample_rate_);
+    std::sort(f.begin(), f.end());
+    ways_ = n + 1;
+    freq_ = f;
+
+    const size_t stages = static_cast<size_t>(sections_ * (ways_ - 1));
+    sections_of_.assign(static_cast<size_t>(max_ways), {});
+    for (int k = 0; k < ways_; ++k)
+      for (size_t st = 0; st < stages; ++st)
+        sections_of_[static_cast<size_t>(k)].push_back(design(st, k));
+
+    state_.assign(static_cast<size_t>(max_channels_ * max_ways), {});
+    out_hist_.assign(static_cast<size_t>(max_channels_ * max_ways), {});
+  }
+
+  void set_gain_db(int way, float db) {
+    db = std::clamp(db, -24.0f, 0.0f);
+    gain_[static_cast<size_t>(way)] = std::pow(10.0f, db / 20.0f);
+  }
+  void set_delay_ms(int way, float ms) {
+    ms = std::clamp(ms, 0.0f, 10.0f);
+    delay_[static_cast<size_t>(way)] =
+        static_cast<size_t>(ms * 0.001f * sample_rate_ + 0.5f);
+  }
+  void set_inverted(int way, bool inverted) {
+    invert_[static_cast<size_t>(way)] = inverted;
+  }
+
+  void process(const float *in, float *out, size_t frames, int in_channels) {
+    const int ch = std::min(in_channels, max_channels_);
+    const size_t out_ch = output_channels(in_channels);
+
+    for (int c = 0; c < ch; ++c) {
+      for (int k = 0; k < ways_; ++k) {
+        const size_t id = static_cast<size_t>(c * max_ways + k);
+        std::vector<float> &z = state_[id];
+        std::vector<float> &hist = out_hist_[id];
+        const size_t stages = static_cast<size_t>(sections_ * (ways_ - 1));
+        z.resize(2 * stages, 0.0f);
+
+        const float g =
+            invert_[static_cast<size_t>(k)] ? -gain_[static_cast<size_t>(k)]
+                                            : gain_[static_cast<size_t>(k)];
+        for (size_t f = 0; f < frames; ++f) {
+          float v = in[f * static_cast<size_t>(in_channels) +
+                       static_cast<size_t>(c)];
+          const std::vector<biquad> &q = sections_of_[static_cast<size_t>(k)];
+          for (size_t s = 0; s < stages; ++s)
+            v = q[s].run(v, z[2 * s], z[2 * s + 1]);
+          hist.push_back(v * g);
+
+          const size_t d = delay_[static_cast<size_t>(k)];
+          const size_t n = hist.size() - 1;
+          out[f * out_ch + static_cast<size_t>(k * ch + c)] =
+              n >= d ? hist[n - d] : 0.0f;
+        }
+      }
+    }
+  }
+
+private:
+  // Sektion s i kaskaden för väg k: delningspunkt j = s / sections_.
+  // Högpass om j < k, lågpass om j == k, annars allpass (bara första
+  // halvan av sektionerna, resten genomsläpp).
+  biquad design(size_t s, int k) const {
+    static constexpr float q_lr4[] = {0.70710678f};
+    static constexpr float q_lr8[] = {0.54119610f, 1.30656296f};
+    const size_t j = s / static_cast<size_t>(sections_);
+    const size_t si = s % static_cast<size_t>(sections_);
+    const size_t nq = sections_ == 4 ? 2 : 1;
+    const float qf = sections_ == 4 ? q_lr8[si % nq] : q_lr4[0];
+
+    biquad q;
+    const size_t kk = static_cast<size_t>(k);
+    if (j > kk && si >= nq)
+      return q; // identitet
+
+    const double w0 = 2.0 * M_PI * freq_[j] / sample_rate_;
+    const double cw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * qf);
+    const double a0 = 1.0 + alpha;
+    double b0, b1, b2;
+    if (j == kk) {
+      b0 = b2 = (1.0 - cw) * 0.5;
+      b1 = 1.0 - cw;
+    } else if (j < kk) {
+      b0 = b2 = (1.0 + cw) * 0.5;
+      b1 = -(1.0 + cw);
+    } else {
+      b0 = 1.0 - alpha;
+      b1 = -2.0 * cw;
+      b2 = 1.0 + alpha;
+    }
+    q.b0 = static_cast<float>(b0 / a0);
+    q.b1 = static_cast<float>(b1 / a0);
+    q.b2 = static_cast<float>(b2 / a0);
+    q.a1 = static_cast<float>(-2.0 * cw / a0);
+    q.a2 = static_cast<float>((1.0 - alpha) / a0);
+    return q;
+  }
+
+  float sample_rate_;
+  int max_channels_;
+  int sections_;
+  int ways_ = 2;
+  std::vector<float> freq_;
+  std::vector<std::vector<biquad>> sections_of_; // per väg
+  std::array<float, max_ways> gain_{};
+  std::array<size_t, max_ways> delay_{};
+  std::array<bool, max_ways> invert_{};
+  std::vector<std::vector<float>> state_;
+  std::vector<std::vector<float>> out_hist_;
+};
+
+// Flerbandsdynamik med standardinställningarna. Delblocken (256 frames)
+// och styrblocken (16 frames) räknas från början av varje process-anrop
+// precis som i produktionskoden, så utgången beror på blockindelningen.
+class multiband_dynamics {
+public:
+  multiband_dynamics(float sample_rate, int max_channels,
+                     const std::vector<float> &split_hz)
+      : sample_rate_(sample_rate), max_channels_(std::min(max_channels, 8)),
+        split_(sample_rate, max_channels_, 4) {
+    split_.set_frequencies(split_hz);
+    bands_ = split_.ways();
+    for (int b = 0; b < bands_; ++b) {
+      const float attack_ms = b == 0 ? 30.0f : 10.0f;
+      const float release_ms = b == 0 ? 300.0f : 150.0f;
+      attack_[b] = coef(attack_ms);
+      release_[b] = coef(release_ms);
+    }
+    env_release_ = std::exp(-1.0f / (0.005f * sample_rate_));
+  }
+
+  void process(float *buf, size_t frames, int channels) {
+    const int ch = std::min(channels, max_channels_);
+    const size_t lanes = static_cast<size_t>(bands_ * ch);
+    if (env_.empty()) {
+      env_.assign(lanes, 0.0f);
+      gain_db_.assign(lanes, 0.0f);
+      gain_lin_.assign(static_cast<size_t>(bands_), 1.0f);
+    }
+
+    constexpr float threshold_db = -18.0f;
+    constexpr float comp_slope = 1.0f - 1.0f / 3.0f;
+    constexpr float expander_threshold_db = -60.0f;
+    constexpr float exp_slope = 0.0f;
+
+    std::vector<float> split(256 * lanes);
+    for (size_t done = 0; done < frames; done += 256) {
+      const size_t n = std::min<size_t>(256, frames - done);
+      float *io = buf + done * static_cast<size_t>(channels);
+      split_.process(io, split.data(), n, channels);
+
+      for (size_t f0 = 0; f0 < n; f0 += 16) {
+        const size_t m = std::min<size_t>(16, n - f0);
+
+        for (size_t f = f0; f < f0 + m; ++f)
+          for (size_t l = 0; l < lanes; ++l)
+            env_[l] = std::max(std::fabs(split[f * lanes + l]),
+                               env_[l] * env_release_);
+
+        for (size_t l = 0; l < lanes; ++l) {
+          const int b = static_cast<int>(l) / ch;
+          const float level =
+              dsp::fast_log2(env_[l] + 1e-9f) * dsp::db_per_log2;
+          const float over = std::max(level - threshold_db, 0.0f);
+          const float under = std::max(expander_threshold_db - level, 0.0f);
+          const float target =
+              -over * comp_slope - std::min(under * exp_slope, 24.0f);
+          const float prev = gain_db_[l];
+          const float c = target < prev ? attack_[b] : release_[b];
+          gain_db_[l] = target + c * (prev - target);
+        }
+
+        float from[4], step[4];
+        for (int b = 0; b < bands_; ++b) {
+          float link = 0.0f;
+          for (int c = 0; c < ch; ++c)
+            link = std::min(link, gain_db_[static_cast<size_t>(b * ch + c)]);
+          const float to = dsp::fast_exp2((link + 0.0f) *
+                                          (1.0f / dsp::db_per_log2));
+          from[b] = gain_lin_[static_cast<size_t>(b)];
+          step[b] = (to - from[b]) / static_cast<float>(m);
+          gain_lin_[static_cast<size_t>(b)] = to;
+        }
+
+        for (size_t i = 0; i < m; ++i) {
+          const size_t f = f0 + i;
+          float *out = io + f * static_cast<size_t>(channels);
+          for (int c = 0; c < ch; ++c) {
+            float s = 0.0f;
+            for (int b = 0; b < bands_; ++b)
+              s += split[f * lanes + static_cast<size_t>(b * ch + c)] *
+                   (from[b] + step[b] * static_cast<float>(i + 1));
+            out[c] = s;
+          }
+        }
+      }
+    }
+  }
+
+private:
+  float coef(float ms) const {
+    return std::exp(-16.0f / (0.001f * ms * sample_rate_));
+  }
+
+  float sample_rate_;
+  int max_channels_;
+  crossover split_;
+  int bands_ = 3;
+  float attack_[4]{}, release_[4]{};
+  float env_release_ = 0.0f;
+  std::vector<float> env_, gain_db_, gain_lin_;
+};
+
+// Mixer med ducking, interleavat och ett sample i taget.
+class mixer {
+public:
+  static constexpr int max_inputs = 8;
+
+  struct input {
+    const float *interleaved = nullptr;
+    size_t frames = 0;
+    float gain_db = 0.0f;
+    int priority = 0;
+    float duck_db = -18.0f;
+    bool restart = false;
+  };
+
+  mixer(int sample_rate, int channels, size_t)
+      : sample_rate_(static_cast<float>(sample_rate)), channels_(channels) {}
+
+  void process(const input *inputs, float *out, size_t frames) {
+    const size_t ch = static_cast<size_t>(channels_);
+    const float block_s = static_cast<float>(frames) / sample_rate_;
+    const size_t hold = static_cast<size_t>(0.3f * sample_rate_);
+    const float attack = std::exp(-block_s / 0.05f);
+    const float release = std::exp(-block_s / 0.6f);
+
+    bool sounding[max_inputs]{};
+    for (int i = 0; i < max_inputs; ++i) {
+      slot &s = slots_[i];
+      if (!inputs[i].interleaved || inputs[i].restart)
+        s = slot{};
+      if (!inputs[i].interleaved)
+        continue;
+      float peak = 0.0f;
+      for (size_t k = 0; k < inputs[i].frames * ch; ++k)
+        peak = std::max(peak, std::fabs(inputs[i].interleaved[k]));
+      if (peak >= 0.00316f)
+        s.hold_left = hold;
+      else
+        s.hold_left -= std::min(s.hold_left, frames);
+      sounding[i] = s.hold_left > 0;
+    }
+
+    for (int i = 0; i < max_inputs; ++i) {
+      if (!inputs[i].interleaved)
+        continue;
+      float target = 0.0f;
+      for (int j = 0; j < max_inputs; ++j)
+        if (j != i && sounding[j] && inputs[j].priority > inputs[i].priority)
+          target = std::min(target, std::min(inputs[j].duck_db, 0.0f));
+      slot &s = slots_[i];
+      const float c = target < s.duck_db ? attack : release;
+      s.duck_db = target + c * (s.duck_db - target);
+    }
+
+    std::fill(out, out + frames * ch, 0.0f);
+    for (int i = 0; i < max_inputs; ++i) {
+      const input &in = inputs[i];
+      if (!in.interleaved)
+        continue;
+      slot &s = slots_[i];
+      const float g1 = std::pow(10.0f, (in.gain_db + s.duck_db) / 20.0f);
+      const float g0 = s.started ? s.gain : g1;
+      s.gain = g1;
+      s.started = true;
+
+      const float step = (g1 - g0) / static_cast<float>(frames);
+      for (size_t f = 0; f < std::min(in.frames, frames); ++f)
+        for (size_t c = 0; c < ch; ++c)
+          out[f * ch + c] +=
+              in.interleaved[f * ch + c] * (g0 + step * static_cast<float>(f + 1));
+    }
+  }
+
+private:
+  struct slot {
+    float gain = 1.0f;
+    bool started = false;
+    float duck_db = 0.0f;
+    size_t hold_left = 0;
+  };
+
+  float sample_rate_;
+  int channels_;
+  slot slots_[max_inputs]{};
+};
+
+// Sampleformat på ingången, little-endian, ett sample i taget.
+inline float s16_to_float(const uint8_t *p) {
+  const int16_t v = static_cast<int16_t>(p[0] | p[1] << 8);
+  return static_cast<float>(v) / 32768.0f;
+}
+
+inline float s24_to_float(const uint8_t *p) {
+  int32_t v = p[0] | p[1] << 8 | p[2] << 16;
+  if (v & 0x800000)
+    v -= 0x1000000;
+  return static_cast<float>(v) / 8388608.0f;
+}
+
+inline float s32_to_float(const uint8_t *p) {
+  const uint32_t u = static_cast<uint32_t>(p[0]) |
+                     static_cast<uint32_t>(p[1]) << 8 |
+                     static_cast<uint32_t>(p[2]) << 16 |
+                     static_cast<uint32_t>(p[3]) << 24;
+  return static_cast<float>(static_cast<int32_t>(u)) / 2147483648.0f;
+}
+
+} // namespace golden
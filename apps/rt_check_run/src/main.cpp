@@ -0,0 +1,233 @@
+// Kör en riktig zon offline med realtidskontrollen påslagen (bygg med
+// -DSPEAKER_RT_CHECK=ON). Zonen läser en genererad fil och körs av
+// dsp_pool som i apps/speaker; zone::run() markerar sig själv som realtid.
+// En konsument i PortAudio-callbackens takt tömmer ringbufferten, medan en
+// kontrolltråd slumpar PATCH /state, preset-byten, ingångar och låtbyten
+// mot en riktig control_server. Avslutar med status 1 om någon allokering
+// eller något mutexlås fångades i realtidstrådarna.
+//
+//   ./build/apps/rt_check_run/rt_check_run [sekunder] [http-port]
+
+#include "zone.h"
+
+#include "audio/dsp_pool.h"
+
+#include "control/control_server.h"
+#include "control/preset_store.h"
+
+#include "rt_check/rt_check.h"
+
+#include <httplib.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int sample_rate = 44100;
+constexpr int channels = 2;
+constexpr size_t callback_frames = 512;
+
+struct parameter {
+  const char *name;
+  float lo;
+  float hi;
+};
+
+// Namn och intervall som PATCH /state tar emot
+const parameter parameters[] = {
+    {"gain_db", -30.0f, 6.0f},
+    {"reverb_delay_ms", 0.0f, 2000.0f},
+    {"reverb_feedback", 0.0f, 0.95f},
+    {"reverb_wet", 0.0f, 1.0f},
+    {"reverb_dry", 0.0f, 1.0f},
+    {"dc_blocker_cutoff_hz", 1.0f, 200.0f},
+    {"eq_low_db", -12.0f, 12.0f},
+    {"eq_mid_db", -12.0f, 12.0f},
+    {"eq_high_db", -12.0f, 12.0f},
+    {"limiter_ceiling_db", -24.0f, 0.0f},
+    {"limiter_lookahead_ms", 1.0f, 5.0f},
+    {"limiter_release_ms", 1.0f, 1000.0f},
+    {"loudness_normalize", 0.0f, 1.0f},
+    {"loudness_target_lufs", -36.0f, -6.0f},
+    {"mbc_threshold_db_0", -60.0f, 0.0f},
+    {"mbc_ratio_1", 1.0f, 20.0f},
+    {"mbc_threshold_db_2", -60.0f, 0.0f},
+    {"mbc_expander_threshold_db_0", -90.0f, 0.0f},
+    {"mbc_expander_ratio_0", 1.0f, 10.0f},
+    {"crossover_gain_db_0", -24.0f, 0.0f},
+    {"crossover_delay_ms_1", 0.0f, 10.0f},
+    {"crossover_invert_1", 0.0f, 1.0f},
+};
+
+// S16-brus i en temporär fil; var tredje sekund följs av två tysta så att
+// viloläget och tystnadsvägen i loudness också körs
+std::string write_noise(const char *name, double seconds, unsigned seed) {
+  std::string path = std::string("/tmp/rt_check_run-") + name + "-XXXXXX";
+  const int fd = mkstemp(path.data());
+  if (fd < 0) {
+    std::perror("mkstemp");
+    std::exit(2);
+  }
+
+  const size_t frames = static_cast<size_t>(seconds * sample_rate);
+  std::vector<int16_t> pcm(frames * channels);
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist(0.0f, 0.5f);
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    const size_t second = i / (channels * sample_rate);
+    const float x = second % 3 == 0 ? dist(rng) : 0.0f;
+    pcm[i] = static_cast<int16_t>(std::clamp(x, -1.0f, 1.0f) * 32767.0f);
+  }
+
+  const char *p = reinterpret_cast<const char *>(pcm.data());
+  size_t left = pcm.size() * sizeof(int16_t);
+  while (left > 0) {
+    const ssize_t n = write(fd, p, left);
+    if (n <= 0) {
+      std::perror("write");
+      std::exit(2);
+    }
+    p += n;
+    left -= static_cast<size_t>(n);
+  }
+  close(fd);
+  return path;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+  const int port = argc > 2 ? std::atoi(argv[2]) : 18080;
+
+  const std::string main_path = write_noise("main", seconds + 1.0, 1234);
+  const std::string extra_path = write_noise("extra", 1.0, 99);
+
+  // samma uppsättning som en zon i apps/speaker med delning
+  zone::config cfg;
+  cfg.id = "main";
+  cfg.sample_rate = sample_rate;
+  cfg.channels = channels;
+  cfg.format = audio::sample_format::s16;
+  cfg.crossover_hz = {120.0f, 2500.0f};
+  cfg.crossover_order = 4;
+  zone z(cfg);
+
+  // två presets med olika kedjor, så att recall byter och tonar över
+  control::preset_store presets;
+  presets.put({"a", {{"gain_db", -6.0f}, {"reverb_wet", 0.2f}}, {}});
+  presets.put({"b",
+               {{"gain_db", 0.0f}, {"mbc_ratio_0", 4.0f}},
+               {"reverb", "eq3band", "dc_blocker", "multiband_dynamics"}});
+
+  control::control_state st = z.state();
+  st.presets = &presets;
+  std::vector<control::zone_state> zone_states;
+  zone_states.push_back({z.id(), std::move(st)});
+  control::control_server server(std::move(zone_states));
+  server.start("127.0.0.1", port);
+
+  std::atomic<bool> running{true};
+  std::atomic<size_t> requests{0};
+
+  // Kontrollsidan: mest parametrar, ibland preset, ingång eller låtbyte
+  std::thread control_thread([&] {
+    httplib::Client cli("127.0.0.1", port);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> pick(0, std::size(parameters) - 1);
+    std::uniform_int_distribution<int> action(0, 99);
+    size_t track = 0;
+
+    while (running.load(std::memory_order_relaxed)) {
+      const int a = action(rng);
+      httplib::Result r;
+      if (a < 85) {
+        const parameter &p = parameters[pick(rng)];
+        const float v = p.lo + (p.hi - p.lo) * unit(rng);
+        r = cli.Patch(std::string("/state?") + p.name + "=" +
+                      std::to_string(v));
+      } else if (a < 90) {
+        r = cli.Post(std::string("/presets/recall?name=") +
+                     (unit(rng) < 0.5f ? "a" : "b"));
+      } else if (a < 93) {
+        r = cli.Post("/inputs?name=extra&priority=10&duck_db=-12&path=" +
+                     extra_path);
+      } else if (a < 95) {
+        r = cli.Patch("/inputs?name=extra&gain_db=" +
+                      std::to_string(-12.0f * unit(rng)));
+      } else if (a < 98) {
+        r = cli.Delete("/inputs?name=extra");
+      } else {
+        r = cli.Post("/now_playing?name=track" + std::to_string(++track));
+      }
+      if (r)
+        requests.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  z.add_primary(main_path);
+
+  audio::dsp_pool pool;
+  pool.add(&z);
+  audio::dsp_pool::config pool_cfg;
+  pool_cfg.threads = 1;
+  pool.start(pool_cfg);
+
+  // Utgången offline: tömmer ringbufferten i PortAudio-callbackens takt
+  std::thread consumer([&] {
+    audio::ring_buffer &rb = z.ring();
+    std::vector<float> out(callback_frames *
+                           static_cast<size_t>(z.out_channels()));
+    const auto period =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(
+                static_cast<double>(callback_frames) / sample_rate));
+    auto next = std::chrono::steady_clock::now();
+    while (running.load(std::memory_order_relaxed)) {
+      {
+        rt_check::realtime_scope rt;
+        for (float &s : out) {
+          if (!rb.pop(s))
+            s = 0.0f;
+        }
+      }
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  });
+
+  const auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(seconds));
+  while (!z.finished() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  running.store(false);
+  control_thread.join();
+  pool.stop();
+  consumer.join();
+  server.stop();
+  unlink(main_path.c_str());
+  unlink(extra_path.c_str());
+
+  const size_t violations = rt_check::violations();
+  std::printf("sena block: %llu, anrop: %zu, överträdelser: %zu\n",
+              static_cast<unsigned long long>(pool.late()), requests.load(),
+              violations);
+  return violations == 0 ? 0 : 1;
+}
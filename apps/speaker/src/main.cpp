@@ -1,141 +1,421 @@
-#include "audio/port_audio_output.h"
-#include "audio/ring_buffer.h"
+#include "zone.h"
+
+#include "audio/dsp_pool.h"
+#include "audio/realtime.h"
+#include "audio/rtp_receiver.h"
+#include "audio/rtp_sender.h"
+#include "audio/sample_format.h"
 
 #include "control/control_server.h"
+#include "control/event_fifo.h"
+#include "control/preset_store.h"
+
+#include "dsp/multiband_dynamics.h"
 
-#include "dsp/dc_blocker.h"
-#include "dsp/distortion.h"
-#include "dsp/effect_chain.h"
-#include "dsp/eq3band.h"
-#include "dsp/gain.h"
-#include "dsp/reverb.h"
+#include "trace/trace.h"
 
-#include <atomic>
+#include <algorithm>
 #include <chrono>
-#include <cstdint>
-#include <cstdio>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <memory>
-#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
+
+namespace {
+
+// --zone id,källa[,enhet]
+struct zone_option {
+  std::string id;
+  std::string path; // fil, FIFO eller "-" (stdin)
+  int device = -1;  // PortAudio-enhet, -1 => standard
+};
+
+struct options {
+  // strömformat på stdin: --rate, --channels, --format (librespot-namn)
+  int sample_rate = 44100;
+  int channels = 2;
+  audio::sample_format format = audio::sample_format::s16;
+  int http_port = 8080;
+  // --rtp-send host:port, skicka bearbetat ljud vidare till andra rum
+  std::string rtp_send;
+  // --rtp-receive [group:]port, spela en ström i stället för stdin
+  std::string rtp_receive;
+  float rtp_latency_ms = 60.0f;
+  // --crossover 120,2500 => 3 vägar per kanal på separata utgångar
+  std::vector<float> crossover_hz;
+  int crossover_order = 4;
+  // --rt-priority N [--rt-policy rr], --dsp-cpu N, --output-cpu N, --mlock
+  audio::rt_config rt;
+  // --trace: spela in hela tiden, SIGUSR1 skriver /tmp/speaker-trace.json
+  bool trace = false;
+  // --zone kök,/run/kok.pcm,2 (en gång per zon). Utan --zone en zon "main"
+  // på stdin och standardutgången.
+  std::vector<zone_option> zones;
+  // --dsp-threads N, standard en per zon upp till antalet kärnor
+  int dsp_threads = 0;
+  // --persistent: utgång och DSP står kvar vid EOF, källan väntar på nästa
+  // skrivare (FIFO) eller klient (tcp:PORT, unix:SÖKVÄG)
+  bool persistent = false;
+  // --presets FILE: förinställningar sparas här och senast valda läses in
+  // vid start. Utan flaggan finns de bara i minnet.
+  std::string presets;
+};
+
+// Okända argument ignoreras (t.ex. "speaker 0" i äldre skript)
+options parse_args(const std::vector<std::string> &args) {
+  options opt;
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string &a = args[i];
+    const bool has_value = i + 1 < args.size();
+    if (a == "--rate" && has_value) {
+      opt.sample_rate = std::atoi(args[++i].c_str());
+    } else if (a == "--channels" && has_value) {
+      opt.channels = std::atoi(args[++i].c_str());
+    } else if (a == "--format" && has_value) {
+      opt.format = audio::parse_sample_format(args[++i]);
+    } else if (a == "--http-port" && has_value) {
+      opt.http_port = std::atoi(args[++i].c_str());
+    } else if (a == "--rtp-send" && has_value) {
+      opt.rtp_send = args[++i];
+    } else if (a == "--rtp-receive" && has_value) {
+      opt.rtp_receive = args[++i];
+    } else if (a == "--rtp-latency-ms" && has_value) {
+      opt.rtp_latency_ms = static_cast<float>(std::atof(args[++i].c_str()));
+    } else if (a == "--crossover" && has_value) {
+      const std::string list = args[++i];
+      for (size_t pos = 0; pos < list.size();) {
+        const size_t comma = list.find(',', pos);
+        opt.crossover_hz.push_back(
+            static_cast<float>(std::atof(list.c_str() + pos)));
+        if (comma == std::string::npos)
+          break;
+        pos = comma + 1;
+      }
+    } else if (a == "--crossover-order" && has_value) {
+      opt.crossover_order = std::atoi(args[++i].c_str());
+    } else if (a == "--rt-priority" && has_value) {
+      opt.rt.priority = std::atoi(args[++i].c_str());
+    } else if (a == "--rt-policy" && has_value) {
+      opt.rt.round_robin = args[++i] == "rr";
+    } else if (a == "--dsp-cpu" && has_value) {
+      opt.rt.dsp_cpu = std::atoi(args[++i].c_str());
+    } else if (a == "--output-cpu" && has_value) {
+      opt.rt.output_cpu = std::atoi(args[++i].c_str());
+    } else if (a == "--mlock") {
+      opt.rt.lock_memory = true;
+    } else if (a == "--trace") {
+      opt.trace = true;
+    } else if (a == "--zone" && has_value) {
+      const std::string v = args[++i];
+      const size_t c1 = v.find(',');
+      if (c1 == std::string::npos || c1 == 0)
+        throw std::runtime_error("--zone id,källa[,enhet]: " + v);
+      const size_t c2 = v.find(',', c1 + 1);
+      zone_option z;
+      z.id = v.substr(0, c1);
+      z.path = v.substr(c1 + 1, c2 == std::string::npos ? std::string::npos
+                                                        : c2 - c1 - 1);
+      if (c2 != std::string::npos)
+        z.device = std::atoi(v.c_str() + c2 + 1);
+      opt.zones.push_back(z);
+    } else if (a == "--dsp-threads" && has_value) {
+      opt.dsp_threads = std::atoi(args[++i].c_str());
+    } else if (a == "--persistent") {
+      opt.persistent = true;
+    } else if (a == "--presets" && has_value) {
+      opt.presets = args[++i];
+    }
+  }
+  return opt;
+}
+
+// Konfigurationsfil med en inställning per rad, samma namn som flaggorna:
+//   rate = 48000
+//   format = S24_3
+//   mlock
+// Raderna blir argument före kommandoraden, så flaggor vinner över filen.
+std::vector<std::string> read_config(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("cannot open config " + path);
+
+  auto trim = [](std::string s) {
+    const size_t b = s.find_first_not_of(" \t\r");
+    const size_t e = s.find_last_not_of(" \t\r");
+    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+  };
+
+  std::vector<std::string> args;
+  std::string line;
+  while (std::getline(in, line)) {
+    line = trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    const size_t eq = line.find('=');
+    args.push_back("--" + trim(line.substr(0, eq)));
+    if (eq != std::string::npos)
+      args.push_back(trim(line.substr(eq + 1)));
+  }
+  return args;
+}
 
-static float s16_to_float(int16_t v) {
-  return static_cast<float>(v) / 32768.0f;
+// "host:port" eller bara "port"
+void split_endpoint(const std::string &s, std::string &host, int &port) {
+  const size_t colon = s.rfind(':');
+  if (colon == std::string::npos) {
+    port = std::atoi(s.c_str());
+    return;
+  }
+  host = s.substr(0, colon);
+  port = std::atoi(s.c_str() + colon + 1);
 }
 
-int main(/* int argc, char **argv */) {
+} // namespace
+
+int main(int argc, char **argv) {
   std::cout << "Startar högtalarsystem...\n";
 
-  // shared state
-  std::atomic<float> gain_db{0.0f};
-  std::atomic<float> reverb_delay_ms{120.0f};
-  std::atomic<float> reverb_feedback{0.25f};
-  std::atomic<float> reverb_wet{0.55f};
-  std::atomic<float> reverb_dry{0.8f};
-  std::atomic<float> dc_blocker_cutoff_hz{10.0f};
-  std::atomic<float> eq_low_db{10.0f};
-  std::atomic<float> eq_mid_db{0.0f};
-  std::atomic<float> eq_high_db{0.0f};
-  std::string now_playing;
-  std::mutex now_playing_mutex;
-
-  constexpr int sample_rate = 44100;
-  constexpr int channels = 2;
-  constexpr float buffer_seconds = .2f;
-
-  // dsp
-  dsp::gain gain;
-  dsp::EffectChain effect_chain;
-
-  auto eq = std::make_unique<dsp::eq3band>(sample_rate);
-  auto *eq_ptr = eq.get();
-  effect_chain.add(std::move(eq));
-
-  auto reverb = std::make_unique<dsp::reverb>(sample_rate, 2000.0f, channels);
-  auto *reverb_ptr = reverb.get();
-  effect_chain.add(std::move(reverb));
-
-  effect_chain.add(std::make_unique<dsp::distortion>());
-
-  auto dc_blocker = std::make_unique<dsp::dc_blocker>(
-      dc_blocker_cutoff_hz.load(std::memory_order_relaxed));
-  auto *dc_blocker_ptr = dc_blocker.get();
-  effect_chain.add(std::move(dc_blocker));
+  options opt;
+  try {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+      if (args[i] == "--config") {
+        std::vector<std::string> file = read_config(args[i + 1]);
+        args.insert(args.begin(), file.begin(), file.end());
+        break;
+      }
+    }
+    opt = parse_args(args);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
 
-  // control server
-  control::control_state state;
-  state.gain_db = &gain_db;
-  state.reverb_delay_ms = &reverb_delay_ms;
-  state.reverb_feedback = &reverb_feedback;
-  state.reverb_wet = &reverb_wet;
-  state.reverb_dry = &reverb_dry;
-  state.dc_blocker_cutoff_hz = &dc_blocker_cutoff_hz;
-  state.eq_low_db = &eq_low_db;
-  state.eq_mid_db = &eq_mid_db;
-  state.eq_high_db = &eq_high_db;
-  state.now_playing = &now_playing;
-  state.now_playing_mutex = &now_playing_mutex;
-
-  control::control_server server(state);
-  server.start("0.0.0.0", 8080);
-
-  audio::ring_buffer rb(static_cast<size_t>(sample_rate) * channels *
-                        buffer_seconds);
-
-  audio::port_audio_output out;
-  out.start(rb, audio::port_audio_output::config{.sampleRate = sample_rate,
-                                                 .channels = channels,
-                                                 .framesPerBuffer = 512});
-
-  constexpr size_t IN_FRAMES = 1024;
-  int16_t in[IN_FRAMES * channels];
-  std::vector<float> buf(IN_FRAMES * channels);
-
-  while (true) {
-    const size_t samples =
-        std::fread(in, sizeof(int16_t), IN_FRAMES * channels, stdin);
-
-    if (samples == 0) {
-      if (std::ferror(stdin)) {
-        std::perror("std fread");
+  const int sample_rate = opt.sample_rate;
+  const int channels = opt.channels;
+  if (sample_rate < 8000 || sample_rate > 192000 || channels < 1 ||
+      channels > dsp::multiband_dynamics::max_supported_channels) {
+    std::cerr << "ogiltigt format: " << sample_rate << " Hz, " << channels
+              << " kanaler (1-"
+              << dsp::multiband_dynamics::max_supported_channels << ")\n";
+    return 1;
+  }
+  std::cout << "Format: " << sample_rate << " Hz, " << channels
+            << " kanaler, " << audio::to_string(opt.format) << "\n";
+
+  if (opt.zones.empty())
+    opt.zones.push_back({"main", "-", -1});
+
+  const bool rtp_sending = !opt.rtp_send.empty();
+  const bool rtp_receiving = !opt.rtp_receive.empty();
+  if ((rtp_sending || rtp_receiving) && opt.zones.size() > 1) {
+    std::cerr << "--rtp-send/--rtp-receive kräver en enda zon\n";
+    return 1;
+  }
+  for (size_t i = 0; i < opt.zones.size(); i++) {
+    // stdin går inte att öppna igen när skrivaren har stängt
+    if (opt.persistent && !rtp_receiving && opt.zones[i].path == "-") {
+      std::cerr << "zon " << opt.zones[i].id
+                << ": --persistent kräver FIFO, tcp:PORT eller unix:SÖKVÄG\n";
+      return 1;
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (opt.zones[i].id == opt.zones[j].id ||
+          (opt.zones[i].path == "-" && opt.zones[j].path == "-")) {
+        std::cerr << "zon " << opt.zones[i].id
+                  << ": id och stdin får bara användas en gång\n";
+        return 1;
       }
+    }
+  }
 
-      break;
+  control::preset_store presets(opt.presets);
+  try {
+    presets.load();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  audio::rt_status rt_status;
+
+  // En zon per rum: egen kedja, mixer, ringbuffert och utgång.
+  // Mottagare i rtp-läge spelar strömmen som den är, utan delning.
+  std::vector<std::unique_ptr<zone>> zones;
+  for (const zone_option &z : opt.zones) {
+    zone::config cfg;
+    cfg.id = z.id;
+    cfg.sample_rate = sample_rate;
+    cfg.channels = channels;
+    cfg.format = opt.format;
+    if (!rtp_receiving) {
+      cfg.crossover_hz = opt.crossover_hz;
+      cfg.crossover_order = opt.crossover_order;
     }
+    cfg.device = z.device;
+    cfg.output_cpu = opt.rt.output_cpu;
+    cfg.persistent = opt.persistent;
+    zones.push_back(std::make_unique<zone>(cfg));
+
+    // senast valda preset; kedjan byts vid första blocket
+    control::preset p;
+    if (presets.find(presets.last(z.id), p)) {
+      try {
+        zones.back()->recall(p);
+        std::cout << "Zon " << z.id << ": preset " << p.name << "\n";
+      } catch (const std::exception &e) {
+        std::cerr << "zon " << z.id << ": preset " << p.name << ": "
+                  << e.what() << "\n";
+      }
+    }
+  }
 
-    const size_t frames = samples / channels;
+  audio::dsp_pool pool;
 
-    // convert to float
-    for (size_t i = 0; i < samples; i++) {
-      buf[i] = s16_to_float(in[i]);
+  // control server
+  std::vector<control::zone_state> zone_states;
+  for (const auto &z : zones) {
+    control::control_state st = z->state();
+    st.presets = &presets;
+    st.health_details = [&rt_status, &pool] {
+      return audio::describe(rt_status) +
+             "dsp_threads: " + std::to_string(pool.threads()) + "\n" +
+             "dsp_late: " + std::to_string(pool.late()) + "\n" +
+             "dsp_steals: " + std::to_string(pool.steals()) + "\n";
+    };
+    zone_states.push_back({z->id(), std::move(st)});
+  }
+
+  // rtp
+  audio::rtp_sender rtp_out;
+  audio::rtp_receiver rtp_in;
+  if (rtp_sending || rtp_receiving) {
+    control::control_state &state = zone_states.front().state;
+    const audio::rtp_stats &st = rtp_receiving ? rtp_in.stats() : rtp_out.stats();
+    state.stream_mode = rtp_receiving ? "receive" : "send";
+    state.stream_packets = &st.packets;
+    state.stream_packets_lost = &st.packets_lost;
+    state.stream_packets_late = &st.packets_late;
+    state.stream_underruns = &st.underruns;
+    state.stream_overruns = &st.overruns;
+    state.stream_latency_ms = &st.latency_ms;
+    state.stream_jitter_ms = &st.jitter_ms;
+    state.stream_drift_ppm = &st.drift_ppm;
+    if (rtp_receiving) {
+      state.stream_clock_anchored = &st.clock_anchored;
+      state.stream_sync_error_ms = &st.sync_error_ms;
     }
+  }
 
-    gain.set_db(gain_db.load(std::memory_order_relaxed));
-    for (size_t i = 0; i < samples; i++) {
-      buf[i] = gain.process(buf[i]);
+  control::control_server server(std::move(zone_states));
+  server.start("0.0.0.0", opt.http_port);
+
+  // librespot --onevent skriver hit (se now_playing.sh); övriga zoner
+  // läser <fifo>-<id>
+  const char *fifo_env = std::getenv("SPEAKER_EVENT_FIFO");
+  const std::string fifo_path = fifo_env ? fifo_env : "/tmp/speaker-events";
+  std::vector<std::unique_ptr<control::event_fifo>> events;
+  for (size_t i = 0; i < zones.size(); i++) {
+    const std::string path =
+        i == 0 ? fifo_path : fifo_path + "-" + zones[i]->id();
+    events.push_back(
+        std::make_unique<control::event_fifo>(zones[i]->now_playing()));
+    try {
+      events.back()->start(path);
+    } catch (const std::exception &e) {
+      std::cerr << "event fifo: " << e.what() << "\n";
     }
+  }
 
-    reverb_ptr->setDelayMs(reverb_delay_ms.load(std::memory_order_relaxed));
-    reverb_ptr->setFeedback(reverb_feedback.load(std::memory_order_relaxed));
-    reverb_ptr->setWet(reverb_wet.load(std::memory_order_relaxed));
-    reverb_ptr->setDry(reverb_dry.load(std::memory_order_relaxed));
-    dc_blocker_ptr->set_cutoff(
-        dc_blocker_cutoff_hz.load(std::memory_order_relaxed));
+  if (opt.trace) {
+    trace::dump_on_signal(SIGUSR1, "/tmp/speaker-trace.json");
+    trace::start();
+  }
 
-    eq_ptr->set_low_db(eq_low_db.load(std::memory_order_relaxed));
-    eq_ptr->set_mid_db(eq_mid_db.load(std::memory_order_relaxed));
-    eq_ptr->set_high_db(eq_high_db.load(std::memory_order_relaxed));
+  if (rtp_receiving) {
+    // mottagare: ingen lokal dsp, strömmen är redan bearbetad hos sändaren.
+    // Realtidsinställningarna görs i respektive tråd; huvudtråden sover.
+    zones.front()->start_output(&rt_status);
 
-    effect_chain.process(buf.data(), frames, channels);
+    audio::rtp_receiver::config cfg;
+    split_endpoint(opt.rtp_receive, cfg.group, cfg.port);
+    cfg.sampleRate = sample_rate;
+    cfg.channels = channels;
+    cfg.latencyMs = opt.rtp_latency_ms;
+    cfg.outputLatencyMs = zones.front()->output_latency_ms();
+    cfg.rt = opt.rt;
+    cfg.status = &rt_status;
+    rtp_in.start(zones.front()->ring(), cfg);
 
-    for (size_t i = 0; i < samples; ++i) {
-      // Backpressure: wait if buffer full
-      while (!rb.push(buf[i])) {
-        std::this_thread::sleep_for(std::chrono::microseconds(200));
-      }
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
     }
   }
 
-  out.stop();
+  if (rtp_sending) {
+    audio::rtp_sender::config cfg;
+    split_endpoint(opt.rtp_send, cfg.host, cfg.port);
+    cfg.sampleRate = sample_rate;
+    cfg.channels = channels;
+    rtp_out.start(cfg);
+    zones.front()->set_rtp_sender(&rtp_out);
+  }
+
+  // Primär ingång per zon: när alla har tagit slut avslutas programmet,
+  // utom med --persistent där de aldrig tar slut
+  for (size_t i = 0; i < zones.size(); i++) {
+    try {
+      zones[i]->add_primary(opt.zones[i].path);
+    } catch (const std::exception &e) {
+      std::cerr << "zon " << zones[i]->id() << ": " << e.what() << "\n";
+      return 1;
+    }
+    pool.add(zones[i].get());
+  }
+
+  // Allt som ljudtrådarna rör är allokerat nu. Varje pooltråd får
+  // prioritet och en egen CPU från --dsp-cpu och uppåt; minnet låses av
+  // den första. Steg som saknar rättigheter hoppas över och syns i /health.
+  audio::dsp_pool::config pool_cfg;
+  pool_cfg.threads =
+      opt.dsp_threads > 0
+          ? opt.dsp_threads
+          : static_cast<int>(std::min<size_t>(
+                zones.size(),
+                std::max(1u, std::thread::hardware_concurrency())));
+  pool_cfg.thread_init = [&opt, &rt_status](int t) {
+    audio::rt_config rt = opt.rt;
+    if (rt.dsp_cpu >= 0)
+      rt.dsp_cpu += t;
+    rt.lock_memory = rt.lock_memory && t == 0;
+    // spårbufferten allokeras före realtid och låses med resten av minnet
+    const std::string name = "dsp " + std::to_string(t);
+    trace::register_thread(name.c_str());
+    audio::setup_dsp_thread(rt, rt_status);
+  };
+  pool.start(pool_cfg);
+
+  for (const auto &z : zones) {
+    z->start_output(&rt_status);
+  }
+
+  while (!std::all_of(zones.begin(), zones.end(),
+                      [](const auto &z) { return z->finished(); })) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  pool.stop();
+  rtp_out.stop();
+  for (const auto &z : zones) {
+    z->stop_output();
+  }
+  for (const auto &e : events) {
+    e->stop();
+  }
   return 0;
 }
@@ -0,0 +1,531 @@
+#include "zone.h"
+
+#include "dsp/distortion.h"
+#include "dsp/silence.h"
+
+#include "rt_check/rt_check.h"
+#include "trace/trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Flyttbara effekter i standardordning; limitern ligger alltid sist
+const char *const default_order[] = {"eq3band", "multiband_dynamics",
+                                     "reverb", "distortion", "dc_blocker"};
+
+// Aktiv delning efter kedjan: fler utgångskanaler än ingångskanaler
+std::unique_ptr<dsp::crossover> make_crossover(const zone::config &cfg) {
+  if (cfg.crossover_hz.empty())
+    return nullptr;
+  auto xo = std::make_unique<dsp::crossover>(
+      static_cast<float>(cfg.sample_rate), cfg.channels, cfg.crossover_order);
+  xo->set_frequencies(cfg.crossover_hz);
+  return xo;
+}
+
+} // namespace
+
+zone::zone(const config &cfg)
+    : cfg_(cfg), crossover_(make_crossover(cfg)),
+      out_channels_(crossover_ ? static_cast<int>(
+                                     crossover_->output_channels(cfg.channels))
+                               : cfg.channels),
+      mixer_(cfg.sample_rate, cfg.channels, cfg.block_frames),
+      in_bufs_(dsp::mixer::max_inputs * cfg.block_frames *
+               static_cast<size_t>(cfg.channels)),
+      buf_(cfg.block_frames * static_cast<size_t>(cfg.channels)),
+      fade_buf_(buf_.size()),
+      out_buf_(crossover_ ? cfg.block_frames * static_cast<size_t>(
+                                                   out_channels_)
+                          : 0),
+      rb_(static_cast<size_t>(cfg.sample_rate) * out_channels_ *
+          cfg.buffer_seconds) {
+  const int sample_rate = cfg.sample_rate;
+  const int channels = cfg.channels;
+  trace_name_ = trace::intern("zone " + cfg.id);
+
+  loudness_.prepare(sample_rate, channels, cfg.block_frames);
+  if (crossover_) {
+    for (int w = 0; w < crossover_->ways(); w++) {
+      way_limiters_.push_back(
+          std::make_unique<dsp::limiter>(sample_rate, channels));
+    }
+  }
+  fade_frames_ = static_cast<size_t>(sample_rate / 20); // 50 ms
+
+  active_ = make_snapshot({}).release();
+  apply_params(active_->fx, [](std::atomic<float> &v) {
+    return v.load(std::memory_order_relaxed);
+  });
+  order_.assign(std::begin(default_order), std::end(default_order));
+
+  state_.gain_db = &gain_db_;
+  state_.reverb_delay_ms = &reverb_delay_ms_;
+  state_.reverb_feedback = &reverb_feedback_;
+  state_.reverb_wet = &reverb_wet_;
+  state_.reverb_dry = &reverb_dry_;
+  state_.dc_blocker_cutoff_hz = &dc_blocker_cutoff_hz_;
+  state_.eq_low_db = &eq_low_db_;
+  state_.eq_mid_db = &eq_mid_db_;
+  state_.eq_high_db = &eq_high_db_;
+  state_.limiter_ceiling_db = &limiter_ceiling_db_;
+  state_.limiter_lookahead_ms = &limiter_lookahead_ms_;
+  state_.limiter_release_ms = &limiter_release_ms_;
+  state_.limiter_gain_reduction_db = &limiter_gain_reduction_db_;
+  state_.mbc_bands = active_->fx.mbc->bands();
+  state_.mbc_threshold_db = mbc_threshold_db_;
+  state_.mbc_ratio = mbc_ratio_;
+  state_.mbc_expander_threshold_db = mbc_expander_threshold_db_;
+  state_.mbc_expander_ratio = mbc_expander_ratio_;
+  state_.mbc_gain_reduction_db = mbc_gain_reduction_db_;
+  if (crossover_) {
+    state_.crossover_ways = crossover_->ways();
+    state_.crossover_gain_db = crossover_gain_db_;
+    state_.crossover_delay_ms = crossover_delay_ms_;
+    state_.crossover_invert = crossover_invert_;
+  }
+  state_.loudness_normalize = &loudness_normalize_;
+  state_.loudness_target_lufs = &loudness_target_lufs_;
+  state_.loudness_momentary_lufs = &loudness_momentary_lufs_;
+  state_.loudness_short_term_lufs = &loudness_short_term_lufs_;
+  state_.loudness_integrated_lufs = &loudness_integrated_lufs_;
+  state_.loudness_gain_db = &loudness_gain_db_;
+  state_.dsp_idle = &dsp_idle_;
+  state_.now_playing = &now_playing_;
+
+  state_.inputs.list = [this] {
+    std::vector<control::input_status> out;
+    for (const audio::input_set::info &in : inputs_.list()) {
+      control::input_status st;
+      st.name = in.name;
+      st.source = in.source;
+      st.gain_db = in.p.gain_db;
+      st.priority = in.p.priority;
+      st.duck_db = in.p.duck_db;
+      st.primary = in.primary;
+      st.playing = in.playing;
+      st.level_db = mixer_.level_db(in.slot);
+      st.ducked_db = mixer_.duck_db(in.slot);
+      st.underruns = in.underruns;
+      st.connected = in.connected;
+      st.reconnects = in.reconnects;
+      st.first_sample_ms = in.first_sample_ms;
+      out.push_back(std::move(st));
+    }
+    return out;
+  };
+  // tillagda ingångar är i regel utrop, så de får högre prioritet än stdin
+  state_.inputs.add = [this](const control::input_request &r) {
+    audio::input_set::params p;
+    p.gain_db = r.gain_db.value_or(0.0f);
+    p.priority = r.priority.value_or(10);
+    p.duck_db = r.duck_db.value_or(-18.0f);
+    inputs_.add(make_source(r), p);
+  };
+  state_.inputs.update = [this](const control::input_request &r) {
+    audio::input_set::params p;
+    if (!inputs_.find(r.name, p))
+      return false;
+    p.gain_db = r.gain_db.value_or(p.gain_db);
+    p.priority = r.priority.value_or(p.priority);
+    p.duck_db = r.duck_db.value_or(p.duck_db);
+    return inputs_.update(r.name, p);
+  };
+  state_.inputs.remove = [this](const std::string &name) {
+    return inputs_.remove(name);
+  };
+
+  state_.recall_preset = [this](const control::preset &p) { recall(p); };
+  state_.effect_order = [this] {
+    std::lock_guard<std::mutex> lock(recall_mu_);
+    return order_;
+  };
+}
+
+zone::~zone() {
+  delete active_;
+  delete next_;
+  delete pending_.load();
+  for (auto &r : retired_)
+    delete r.load();
+}
+
+std::unique_ptr<zone::snapshot>
+zone::make_snapshot(const std::vector<std::string> &order) const {
+  const int sample_rate = cfg_.sample_rate;
+  const int channels = cfg_.channels;
+  auto s = std::make_unique<snapshot>();
+  chain &c = s->fx;
+
+  std::vector<std::string> names = order;
+  if (names.empty())
+    names.assign(std::begin(default_order), std::end(default_order));
+  for (size_t i = 0; i < names.size(); i++) {
+    const std::string &n = names[i];
+    if (std::find(names.begin(), names.begin() + static_cast<std::ptrdiff_t>(i),
+                  n) != names.begin() + static_cast<std::ptrdiff_t>(i))
+      throw std::runtime_error("effect twice in order: " + n);
+
+    if (n == "eq3band") {
+      auto eq = std::make_unique<dsp::eq3band>(sample_rate, channels);
+      c.eq = eq.get();
+      c.effects.add(std::move(eq));
+    } else if (n == "multiband_dynamics") {
+      auto mbc = std::make_unique<dsp::multiband_dynamics>(
+          static_cast<float>(sample_rate), channels);
+      c.mbc = mbc.get();
+      c.effects.add(std::move(mbc));
+    } else if (n == "reverb") {
+      auto reverb =
+          std::make_unique<dsp::reverb>(sample_rate, 2000.0f, channels);
+      c.reverb = reverb.get();
+      c.effects.add(std::move(reverb));
+    } else if (n == "distortion") {
+      c.effects.add(std::make_unique<dsp::distortion>());
+    } else if (n == "dc_blocker") {
+      auto dc_blocker = std::make_unique<dsp::dc_blocker>(10.0, channels);
+      c.dc_blocker = dc_blocker.get();
+      c.effects.add(std::move(dc_blocker));
+    } else {
+      throw std::runtime_error("unknown effect in order: " + n);
+    }
+  }
+
+  // sist i kedjan: inget efter limitern får höja nivån (delningsfiltret
+  // har sina egna per väg)
+  auto limiter = std::make_unique<dsp::limiter>(sample_rate, channels);
+  c.limiter = limiter.get();
+  c.effects.add(std::move(limiter));
+
+  c.effects.prepare(sample_rate, channels, cfg_.block_frames);
+  return s;
+}
+
+// get(atomic) ger värdet att ställa in: atomicen själv i ljudtråden, en
+// presets värde när en ny kedja förbereds
+template <typename Get>
+void zone::apply_params(chain &c, Get &&get) noexcept {
+  if (c.reverb) {
+    c.reverb->setDelayMs(get(reverb_delay_ms_));
+    c.reverb->setFeedback(get(reverb_feedback_));
+    c.reverb->setWet(get(reverb_wet_));
+    c.reverb->setDry(get(reverb_dry_));
+  }
+  if (c.dc_blocker)
+    c.dc_blocker->set_cutoff(get(dc_blocker_cutoff_hz_));
+
+  // eq räknar bara om koefficienterna när ett värde har ändrats
+  if (c.eq) {
+    c.eq->set_low_db(get(eq_low_db_));
+    c.eq->set_mid_db(get(eq_mid_db_));
+    c.eq->set_high_db(get(eq_high_db_));
+  }
+
+  if (c.mbc) {
+    for (int b = 0; b < c.mbc->bands(); b++) {
+      c.mbc->set_threshold_db(b, get(mbc_threshold_db_[b]));
+      c.mbc->set_ratio(b, get(mbc_ratio_[b]));
+      c.mbc->set_expander(b, get(mbc_expander_threshold_db_[b]),
+                          get(mbc_expander_ratio_[b]));
+    }
+  }
+
+  c.limiter->set_ceiling_db(get(limiter_ceiling_db_));
+  c.limiter->set_lookahead_ms(get(limiter_lookahead_ms_));
+  c.limiter->set_release_ms(get(limiter_release_ms_));
+}
+
+void zone::recall(const control::preset &p) {
+  // presetens värden, nuvarande för det som saknas (t.ex. äldre fil)
+  std::vector<std::pair<std::atomic<float> *, float>> values;
+  for (const control::state_param &sp : control::state_params(state_)) {
+    if (!sp.target)
+      continue;
+    float v = sp.target->load(std::memory_order_relaxed);
+    for (const auto &[name, x] : p.values) {
+      if (name == sp.name)
+        v = std::clamp(x, sp.min, sp.max);
+    }
+    values.emplace_back(sp.target, v);
+  }
+
+  std::unique_ptr<snapshot> s = make_snapshot(p.order);
+  s->values = std::move(values);
+  apply_params(s->fx, [&s](std::atomic<float> &a) {
+    for (const auto &[target, v] : s->values) {
+      if (target == &a)
+        return v;
+    }
+    return a.load(std::memory_order_relaxed);
+  });
+
+  std::lock_guard<std::mutex> lock(recall_mu_);
+  for (auto &r : retired_)
+    delete r.exchange(nullptr, std::memory_order_acq_rel);
+  // en tidigare som ljudtråden aldrig tog
+  delete pending_.exchange(s.release(), std::memory_order_acq_rel);
+  if (p.order.empty())
+    order_.assign(std::begin(default_order), std::end(default_order));
+  else
+    order_ = p.order;
+}
+
+std::unique_ptr<audio::input_source>
+zone::make_source(const control::input_request &r, bool reconnect) const {
+  audio::input_source::config cfg;
+  cfg.name = r.name;
+  cfg.type = r.capture ? audio::input_source::kind::capture
+                       : audio::input_source::kind::file;
+  cfg.path = r.path;
+  cfg.format =
+      r.format.empty() ? cfg_.format : audio::parse_sample_format(r.format);
+  cfg.sampleRate = cfg_.sample_rate;
+  cfg.channels = cfg_.channels;
+  cfg.reconnect = reconnect;
+  auto src = std::make_unique<audio::input_source>();
+  src->start(cfg);
+  return src;
+}
+
+void zone::add_primary(const std::string &path) {
+  control::input_request r;
+  r.name = path == "-" ? "stdin" : "main";
+  r.path = path;
+  audio::input_set::params p;
+  p.priority = 0;
+  inputs_.add(make_source(r, cfg_.persistent), p, true);
+}
+
+void zone::start_output(audio::rt_status *status) {
+  out_.start(rb_, audio::port_audio_output::config{
+                      .sampleRate = cfg_.sample_rate,
+                      .channels = out_channels_,
+                      .framesPerBuffer = 512,
+                      .device = cfg_.device,
+                      .cpu = cfg_.output_cpu,
+                      .status = status});
+  output_latency_ns_.store(
+      static_cast<uint64_t>(out_.output_latency_ms() * 1e6f),
+      std::memory_order_relaxed);
+}
+
+void zone::stop_output() { out_.stop(); }
+
+uint64_t zone::deadline_ns(uint64_t now_ns) const noexcept {
+  const size_t block = cfg_.block_frames * static_cast<size_t>(out_channels_);
+  const size_t queued = rb_.count();
+  if (finished() || rb_.capacity() - queued < block)
+    return audio::dsp_pool::not_ready;
+
+  // utgången spelar det som ligger i bufferten, sedan tystnad
+  const uint64_t frames = queued / static_cast<size_t>(out_channels_);
+  return now_ns + frames * 1'000'000'000ull /
+                      static_cast<uint64_t>(cfg_.sample_rate);
+}
+
+// Från ingångarna till ringbufferten får inget allokera eller låsa. Poolen
+// kör bara blocket när det får plats, så push nedan väntar aldrig.
+void zone::run() noexcept {
+  const size_t frames = cfg_.block_frames;
+  const size_t samples = frames * static_cast<size_t>(cfg_.channels);
+  const int channels = cfg_.channels;
+
+  if (rb_.capacity() - rb_.count() <
+      frames * static_cast<size_t>(out_channels_))
+    return;
+
+  rt_check::enter();
+  trace::scope t_zone(trace_name_);
+
+  dsp::mixer::input mix_in[dsp::mixer::max_inputs];
+  {
+    trace::scope t("inputs");
+    for (int i = 0; i < dsp::mixer::max_inputs; i++) {
+      float *in = &in_bufs_[static_cast<size_t>(i) * samples];
+      const audio::input_set::block b = inputs_.pull(i, in, frames);
+      if (!b.present)
+        continue;
+      mix_in[i].interleaved = in;
+      mix_in[i].frames = b.frames;
+      mix_in[i].gain_db = b.p.gain_db;
+      mix_in[i].priority = b.p.priority;
+      mix_in[i].duck_db = b.p.duck_db;
+      mix_in[i].restart = b.restart;
+    }
+  }
+  {
+    trace::scope t("mixer");
+    mixer_.process(mix_in, buf_.data(), frames);
+    finished_.store(inputs_.primary_finished(), std::memory_order_relaxed);
+    inputs_.end_block();
+  }
+
+  // preset: ny kedja när förra övertoningen är klar och det finns plats
+  // att lämna tillbaka den gamla
+  if (!next_ && (!retired_[0].load(std::memory_order_acquire) ||
+                 !retired_[1].load(std::memory_order_acquire))) {
+    if (snapshot *s = pending_.exchange(nullptr, std::memory_order_acq_rel)) {
+      fade_from_gain_ = gain_.linear();
+      for (const auto &[target, v] : s->values)
+        target->store(v, std::memory_order_relaxed);
+      next_ = s;
+      fade_pos_ = 0;
+    }
+  }
+
+  loudness_.set_normalize(
+      loudness_normalize_.load(std::memory_order_relaxed) >= 0.5f);
+  loudness_.set_target_lufs(
+      loudness_target_lufs_.load(std::memory_order_relaxed));
+  // ny låt => nytt integrerat medel
+  const uint64_t track_changes = now_playing_.track_changes();
+  if (track_changes != track_changes_) {
+    track_changes_ = track_changes;
+    loudness_.reset_integration();
+  }
+  // mäter låten som den kommer, före gain och klang; tystnad räknas utan
+  // filtren så att mätvärdena faller
+  if (!next_ && active_->fx.effects.idle() && loudness_.tail_decayed() &&
+      dsp::is_silent(buf_.data(), samples)) {
+    loudness_.process_silence(frames);
+  } else {
+    trace::scope t(loudness_.name());
+    loudness_.process(buf_.data(), frames, channels);
+  }
+
+  {
+    trace::scope t("gain");
+    gain_.set_db(gain_db_.load(std::memory_order_relaxed));
+    if (next_) {
+      // den gamla kedjan får sin gamla gain till övertoningen är klar
+      for (size_t i = 0; i < samples; i++) {
+        fade_buf_[i] = gain_.process(buf_[i]);
+        buf_[i] *= fade_from_gain_;
+      }
+    } else {
+      for (size_t i = 0; i < samples; i++) {
+        buf_[i] = gain_.process(buf_[i]);
+      }
+    }
+  }
+
+  auto load = [](std::atomic<float> &v) {
+    return v.load(std::memory_order_relaxed);
+  };
+  // under övertoningen behåller den gamla kedjan värdena från före recall
+  if (!next_)
+    apply_params(active_->fx, load);
+  active_->fx.effects.process(buf_.data(), frames, channels);
+
+  if (next_) {
+    trace::scope t("preset fade");
+    apply_params(next_->fx, load);
+    next_->fx.effects.process(fade_buf_.data(), frames, channels);
+
+    // linjär övertoning; kedjorna får samma ingång och är korrelerade
+    const float step = 1.0f / static_cast<float>(fade_frames_);
+    for (size_t f = 0; f < frames; f++) {
+      const float w =
+          std::min(1.0f, static_cast<float>(fade_pos_ + f + 1) * step);
+      float *a = &buf_[f * static_cast<size_t>(channels)];
+      const float *b = &fade_buf_[f * static_cast<size_t>(channels)];
+      for (int c = 0; c < channels; c++)
+        a[c] += w * (b[c] - a[c]);
+    }
+
+    fade_pos_ += frames;
+    if (fade_pos_ >= fade_frames_) {
+      snapshot *expected = nullptr;
+      if (!retired_[0].compare_exchange_strong(expected, active_,
+                                               std::memory_order_acq_rel))
+        retired_[1].store(active_, std::memory_order_release);
+      active_ = next_;
+      next_ = nullptr;
+    }
+  }
+
+  const chain &fx = active_->fx;
+  const bool idle = !next_ && fx.effects.idle();
+  dsp_idle_.store(idle, std::memory_order_relaxed);
+
+  float reduction_db = fx.limiter->gain_reduction_db();
+  for (const auto &l : way_limiters_)
+    reduction_db = std::max(reduction_db, l->gain_reduction_db());
+  limiter_gain_reduction_db_.store(reduction_db, std::memory_order_relaxed);
+  loudness_momentary_lufs_.store(loudness_.momentary_lufs(),
+                                 std::memory_order_relaxed);
+  loudness_short_term_lufs_.store(loudness_.short_term_lufs(),
+                                  std::memory_order_relaxed);
+  loudness_integrated_lufs_.store(loudness_.integrated_lufs(),
+                                  std::memory_order_relaxed);
+  loudness_gain_db_.store(loudness_.gain_db(), std::memory_order_relaxed);
+  for (int b = 0; b < dsp::multiband_dynamics::max_bands; b++) {
+    mbc_gain_reduction_db_[b].store(fx.mbc ? fx.mbc->gain_reduction_db(b)
+                                           : 0.0f,
+                                    std::memory_order_relaxed);
+  }
+
+  if (rtp_) {
+    trace::scope t("rtp");
+    // hörs här när det som redan ligger i rb_ har spelats, efter vägarnas
+    // limiters
+    uint64_t queued = rb_.count() / static_cast<size_t>(out_channels_);
+    if (!way_limiters_.empty())
+      queued += way_limiters_.front()->latency_frames();
+    rtp_->push(buf_.data(), frames,
+               audio::wallclock_ns() +
+                   queued * 1'000'000'000ull /
+                       static_cast<uint64_t>(cfg_.sample_rate) +
+                   output_latency_ns_.load(std::memory_order_relaxed));
+  }
+
+  const float *play = buf_.data();
+  size_t play_samples = samples;
+  if (crossover_) {
+    for (int w = 0; w < crossover_->ways(); w++) {
+      crossover_->set_gain_db(
+          w, crossover_gain_db_[w].load(std::memory_order_relaxed));
+      crossover_->set_delay_ms(
+          w, crossover_delay_ms_[w].load(std::memory_order_relaxed));
+      crossover_->set_inverted(
+          w, crossover_invert_[w].load(std::memory_order_relaxed) >= 0.5f);
+    }
+    bool limiters_decayed = true;
+    for (const auto &l : way_limiters_) {
+      l->set_ceiling_db(load(limiter_ceiling_db_));
+      l->set_lookahead_ms(load(limiter_lookahead_ms_));
+      l->set_release_ms(load(limiter_release_ms_));
+      limiters_decayed = limiters_decayed && l->tail_decayed();
+    }
+    // kedjan vilar => tyst in till delningsfiltret; hoppa över det också
+    // när dess och limiternas minne har klingat av
+    if (idle && crossover_->tail_decayed() && limiters_decayed) {
+      std::fill(out_buf_.begin(),
+                out_buf_.begin() + static_cast<std::ptrdiff_t>(
+                                       frames * out_channels_),
+                0.0f);
+    } else {
+      trace::scope t("crossover");
+      crossover_->process(buf_.data(), out_buf_.data(), frames, channels);
+      // varje väg för sig: dess kanaler med utgångens steg mellan frames
+      for (size_t w = 0; w < way_limiters_.size(); w++) {
+        way_limiters_[w]->process(out_buf_.data() + w * static_cast<size_t>(
+                                                        channels),
+                                  frames, out_channels_);
+      }
+    }
+    play = out_buf_.data();
+    play_samples = frames * static_cast<size_t>(out_channels_);
+  }
+
+  {
+    trace::scope t("push");
+    for (size_t i = 0; i < play_samples; ++i) {
+      rb_.push(play[i]);
+    }
+  }
+
+  rt_check::leave();
+}
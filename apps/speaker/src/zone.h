@@ -0,0 +1,200 @@
+#pragma once
+
+#include "audio/dsp_pool.h"
+#include "audio/input_set.h"
+#include "audio/input_source.h"
+#include "audio/port_audio_output.h"
+#include "audio/realtime.h"
+#include "audio/ring_buffer.h"
+#include "audio/rtp_sender.h"
+#include "audio/sample_format.h"
+
+#include "control/control_server.h"
+#include "control/now_playing.h"
+
+#include "dsp/crossover.h"
+#include "dsp/dc_blocker.h"
+#include "dsp/effect_chain.h"
+#include "dsp/eq3band.h"
+#include "dsp/gain.h"
+#include "dsp/limiter.h"
+#include "dsp/loudness.h"
+#include "dsp/mixer.h"
+#include "dsp/multiband_dynamics.h"
+#include "dsp/reverb.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// En zon: egna ingångar och mixer, DSP-kedja, ringbuffert och utgång samt
+// kontrolltillståndet som /zones/<id>/... pekar på. Blocken körs som jobb
+// i dsp_pool; run() gör det producentloopen gjorde för ett block.
+class zone final : public audio::dsp_pool::job {
+public:
+  struct config {
+    std::string id;
+    int sample_rate = 44100;
+    int channels = 2;
+    audio::sample_format format = audio::sample_format::s16;
+    std::vector<float> crossover_hz; // tom => ingen delning
+    int crossover_order = 4;
+    int device = -1; // PortAudio-enhet, -1 => standard
+    int output_cpu = -1;
+    size_t block_frames = 1024;
+    float buffer_seconds = 0.2f;
+    // primära källan väntar på nästa skrivare vid EOF i stället för att
+    // ta slut; utgången spelar tystnad under tiden
+    bool persistent = false;
+  };
+
+  explicit zone(const config &cfg);
+  // Efter stop_output() och att poolen har stoppats
+  ~zone() override;
+
+  zone(const zone &) = delete;
+  zone &operator=(const zone &) = delete;
+
+  const std::string &id() const { return cfg_.id; }
+  int out_channels() const { return out_channels_; }
+
+  // Primär ingång: fil, FIFO, tcp:PORT, unix:SÖKVÄG eller "-" för stdin.
+  // Kastar vid fel.
+  void add_primary(const std::string &path);
+  // Sant när den primära ingången har tagit slut. Sätts av run(), där
+  // ingångarnas källor får läsas.
+  bool finished() const { return finished_.load(std::memory_order_relaxed); }
+
+  // Förbereder kedja och koefficienter för p här och lämnar över allt i
+  // ett svep till ljudtråden, som tonar över från den gamla kedjan. Går att
+  // anropa före start. Kastar std::runtime_error vid okänd effekt.
+  void recall(const control::preset &p);
+
+  // Skickar bearbetat ljud vidare som RTP, före eventuell delning
+  void set_rtp_sender(audio::rtp_sender *s) { rtp_ = s; }
+
+  void start_output(audio::rt_status *status);
+  void stop_output();
+  float output_latency_ms() const { return out_.output_latency_ms(); }
+
+  // rtp-mottagare skriver direkt hit i stället för DSP-kedjan
+  audio::ring_buffer &ring() { return rb_; }
+
+  control::control_state &state() { return state_; }
+  control::now_playing_store &now_playing() { return now_playing_; }
+
+  uint64_t deadline_ns(uint64_t now_ns) const noexcept override;
+  void run() noexcept override;
+
+private:
+  // Effekterna mellan loudness och delningsfiltret, i en viss ordning.
+  // Byts i sin helhet vid recall.
+  struct chain {
+    dsp::EffectChain effects;
+    dsp::eq3band *eq = nullptr;
+    dsp::multiband_dynamics *mbc = nullptr;
+    dsp::reverb *reverb = nullptr;
+    dsp::dc_blocker *dc_blocker = nullptr;
+    dsp::limiter *limiter = nullptr;
+  };
+
+  // Förberedd preset: färdig kedja och värden att publicera i state_
+  struct snapshot {
+    chain fx;
+    std::vector<std::pair<std::atomic<float> *, float>> values;
+  };
+
+  std::unique_ptr<audio::input_source>
+  make_source(const control::input_request &r, bool reconnect = false) const;
+
+  // Tom ordning => standard. Limitern ligger alltid sist.
+  std::unique_ptr<snapshot>
+  make_snapshot(const std::vector<std::string> &order) const;
+  template <typename Get> void apply_params(chain &c, Get &&get) noexcept;
+
+  config cfg_;
+  const char *trace_name_ = "";
+
+  // kontrolltillstånd
+  std::atomic<float> gain_db_{0.0f};
+  std::atomic<float> reverb_delay_ms_{120.0f};
+  std::atomic<float> reverb_feedback_{0.25f};
+  std::atomic<float> reverb_wet_{0.55f};
+  std::atomic<float> reverb_dry_{0.8f};
+  std::atomic<float> dc_blocker_cutoff_hz_{10.0f};
+  std::atomic<float> eq_low_db_{10.0f};
+  std::atomic<float> eq_mid_db_{0.0f};
+  std::atomic<float> eq_high_db_{0.0f};
+  std::atomic<float> limiter_ceiling_db_{-1.0f};
+  std::atomic<float> limiter_lookahead_ms_{2.0f};
+  std::atomic<float> limiter_release_ms_{80.0f};
+  std::atomic<float> limiter_gain_reduction_db_{0.0f};
+  // ratio 1 => multibandet är neutralt tills någon skruvar på det
+  std::atomic<float> mbc_threshold_db_[dsp::multiband_dynamics::max_bands]{
+      -18.0f, -18.0f, -18.0f, -18.0f};
+  std::atomic<float> mbc_ratio_[dsp::multiband_dynamics::max_bands]{
+      1.0f, 1.0f, 1.0f, 1.0f};
+  // expandern är av (ratio 1) som standard
+  std::atomic<float>
+      mbc_expander_threshold_db_[dsp::multiband_dynamics::max_bands]{
+          -60.0f, -60.0f, -60.0f, -60.0f};
+  std::atomic<float> mbc_expander_ratio_[dsp::multiband_dynamics::max_bands]{
+      1.0f, 1.0f, 1.0f, 1.0f};
+  std::atomic<float>
+      mbc_gain_reduction_db_[dsp::multiband_dynamics::max_bands]{};
+  std::atomic<float> crossover_gain_db_[dsp::crossover::max_ways]{};
+  std::atomic<float> crossover_delay_ms_[dsp::crossover::max_ways]{};
+  std::atomic<float> crossover_invert_[dsp::crossover::max_ways]{};
+  // loudness: normalisering av (0/1) och mål; resten skrivs av ljudtråden
+  std::atomic<float> loudness_normalize_{0.0f};
+  std::atomic<float> loudness_target_lufs_{-18.0f};
+  std::atomic<float> loudness_momentary_lufs_{dsp::loudness::min_lufs};
+  std::atomic<float> loudness_short_term_lufs_{dsp::loudness::min_lufs};
+  std::atomic<float> loudness_integrated_lufs_{dsp::loudness::min_lufs};
+  std::atomic<float> loudness_gain_db_{0.0f};
+  std::atomic<bool> dsp_idle_{false};
+  control::now_playing_store now_playing_;
+  control::control_state state_;
+
+  // dsp
+  dsp::gain gain_;
+  // utanför kedjan så att mätningen och makeup gain överlever recall
+  dsp::loudness loudness_;
+  uint64_t track_changes_ = 0; // senast sedda från now_playing_
+
+  // Kedjor. active_ och next_ ägs av ljudtråden. recall() lägger en ny i
+  // pending_; ljudtråden tar den när förra övertoningen är klar och lägger
+  // den uttonade i retired_, som recall() raderar nästa gång. Mellan två
+  // recall hinner högst två kedjor bli över.
+  snapshot *active_ = nullptr;
+  snapshot *next_ = nullptr;
+  float fade_from_gain_ = 1.0f; // gain för active_ under övertoningen
+  size_t fade_pos_ = 0;
+  size_t fade_frames_ = 0;
+  std::atomic<snapshot *> pending_{nullptr};
+  std::atomic<snapshot *> retired_[2]{};
+  std::mutex recall_mu_;
+  std::vector<std::string> order_; // skyddas av recall_mu_
+
+  std::unique_ptr<dsp::crossover> crossover_;
+  // en per väg efter delningsfiltret, vars vägar kan slå över taket
+  std::vector<std::unique_ptr<dsp::limiter>> way_limiters_;
+  int out_channels_ = 0;
+
+  audio::input_set inputs_;
+  std::atomic<bool> finished_{false};
+  dsp::mixer mixer_;
+  std::vector<float> in_bufs_;
+  std::vector<float> buf_;
+  std::vector<float> fade_buf_;
+  std::vector<float> out_buf_;
+
+  audio::ring_buffer rb_;
+  audio::port_audio_output out_;
+  audio::rtp_sender *rtp_ = nullptr;
+  // utgångens fördröjning efter rb_, sätts av start_output()
+  std::atomic<uint64_t> output_latency_ns_{0};
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+namespace audio {
+
+// Fast pool av DSP-trådar för flera zoner i samma process.
+//
+// Varje jobb (en zons nästa block) har en hemtråd. En tråd kör bland sina
+// egna jobb det som har tidigast deadline, dvs. vars utgång tar slut först.
+// Har den inget att göra stjäl den ett jobb från en annan tråd, men bara
+// om det är bråttom (deadline inom steal_slack_ms), så att zonerna annars
+// stannar i samma cache. Jobbmängden är fast efter start().
+class dsp_pool {
+public:
+  static constexpr uint64_t not_ready = std::numeric_limits<uint64_t>::max();
+
+  class job {
+  public:
+    virtual ~job() = default;
+
+    // Tidpunkt (steady_clock, ns) då utgången går tom om inget körs, eller
+    // not_ready om ett block inte får plats nu. Anropas från alla trådar.
+    virtual uint64_t deadline_ns(uint64_t now_ns) const noexcept = 0;
+
+    // Ett block. Körs aldrig samtidigt i två trådar.
+    virtual void run() noexcept = 0;
+  };
+
+  struct config {
+    int threads = 1;
+    float steal_slack_ms = 50.0f;
+    // Anropas först i varje tråd (prioritet, CPU, FTZ), index 0..threads-1
+    std::function<void(int)> thread_init;
+  };
+
+  dsp_pool();
+  ~dsp_pool();
+
+  // Före start(). Jobbet måste leva tills stop().
+  void add(job *j);
+
+  void start(const config &cfg);
+  void stop();
+
+  // Block som startade efter sin deadline (utgången hade redan gått tom)
+  uint64_t late() const noexcept;
+  // Block som kördes av en annan tråd än jobbets hemtråd
+  uint64_t steals() const noexcept;
+  int threads() const noexcept;
+
+  struct impl;
+
+private:
+  impl *impl_ = nullptr;
+};
+
+} // namespace audio
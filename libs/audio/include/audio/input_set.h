@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio/input_source.h"
+
+namespace audio {
+
+// Fasta platser för mixerns ingångar. Kontrolltråden lägger till och tar
+// bort källor medan ljudet spelar; ljudtråden läser bara atomiska pekare
+// och parametrar och tar aldrig lås.
+//
+// En borttagen källa raderas först när ljudtråden har avslutat ett block
+// efter borttagningen (end_block räknar upp en epok), så att ett block som
+// redan har läst pekaren kan bli klart.
+class input_set {
+public:
+  static constexpr int max_inputs = 8;
+
+  struct params {
+    float gain_db = 0.0f;
+    int priority = 0;
+    // sänkning av ingångar med lägre prioritet när denna låter
+    float duck_db = -18.0f;
+  };
+
+  struct info {
+    int slot = -1;
+    std::string name;
+    std::string source; // sökväg, "-" eller "capture"
+    params p;
+    bool primary = false;
+    bool playing = false;
+    uint64_t underruns = 0;
+    bool connected = false;
+    uint64_t reconnects = 0;
+    float first_sample_ms = -1.0f;
+  };
+
+  input_set();
+  ~input_set();
+
+  // Kontrolltråden. src ska vara startad. Primära källor (stdin) tas inte
+  // bort automatiskt när de tar slut. Kastar std::runtime_error om namnet
+  // finns eller alla platser är upptagna; returnerar platsen.
+  int add(std::unique_ptr<input_source> src, const params &p,
+          bool primary = false);
+  bool remove(const std::string &name);
+  bool update(const std::string &name, const params &p);
+  bool find(const std::string &name, params &p) const;
+  std::vector<info> list() const;
+
+  // Någon primär källa har tagit slut.
+  bool primary_finished() const noexcept;
+
+  // Ljudtråden
+  struct block {
+    bool present = false; // källa i platsen
+    bool restart = false; // ny källa sedan förra blocket
+    size_t frames = 0;
+    params p;
+  };
+  block pull(int slot, float *out, size_t frames) noexcept;
+  void end_block() noexcept;
+
+private:
+  struct slot {
+    std::atomic<input_source *> src{nullptr};
+    std::atomic<float> gain_db{0.0f};
+    std::atomic<int> priority{0};
+    std::atomic<float> duck_db{0.0f};
+    std::atomic<bool> primary{false};
+    std::atomic<uint32_t> generation{0};
+    uint32_t seen_generation = 0; // endast ljudtråden
+  };
+
+  struct retired {
+    input_source *src;
+    uint64_t epoch;
+  };
+
+  void detach(int i);
+  void reap();
+
+  slot slots_[max_inputs];
+  std::atomic<uint64_t> epoch_{0};
+
+  mutable std::mutex mutex_; // kontrolltrådar och städtråden
+  std::vector<retired> retired_;
+
+  std::thread reaper_;
+  std::atomic<bool> running_{true};
+};
+
+} // namespace audio
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "audio/sample_format.h"
+
+namespace audio {
+
+// En ingång till mixern med egen ringbuffert: rå PCM från stdin (librespot),
+// en fil eller FIFO (t.ex. ringklocka), en socket eller line-in via
+// PortAudio. Formatet måste ha strömmens samplerate och kanalantal; ingen
+// resampling.
+//
+// Med reconnect är EOF från en FIFO eller socket inte slutet: ingången
+// tystnar och väntar på nästa skrivare (librespot som startar om) eller
+// anslutning, utan att mixern eller utgången märker något.
+class input_source {
+public:
+  enum class kind { file, capture };
+
+  struct config {
+    std::string name;
+    kind type = kind::file;
+    // "-" => stdin, "tcp:PORT" eller "unix:SÖKVÄG" => lyssnande socket
+    // (en klient i taget), annars sökväg till fil eller FIFO
+    std::string path = "-";
+    sample_format format = sample_format::s16;
+    int sampleRate = 44100;
+    int channels = 2;
+    float bufferMs = 500.0f;
+    // så mycket ska ligga i bufferten innan ingången spelar (igen)
+    float prebufferMs = 100.0f;
+    // vänta på ny skrivare/klient vid EOF i stället för att ta slut
+    bool reconnect = false;
+  };
+
+  input_source();
+  ~input_source();
+
+  // Kastar std::runtime_error om källan inte går att öppna.
+  void start(const config &cfg);
+  // Stoppar läsningen. pull() går att anropa även efteråt.
+  void stop();
+
+  const config &cfg() const;
+
+  // Ljudtråden: hämtar upp till frames hela frames, returnerar antalet.
+  // Under förbuffring levereras inget.
+  size_t pull(float *out, size_t frames) noexcept;
+
+  // Källan är slut (EOF) och bufferten tömd.
+  bool finished() const noexcept;
+  bool playing() const noexcept;
+  uint64_t underruns() const noexcept;
+
+  // Det finns en skrivare/klient som har skickat data
+  bool connected() const noexcept;
+  // Anslutningar efter den första
+  uint64_t reconnects() const noexcept;
+  // Från första byten i senaste anslutningen till första samplet ut till
+  // mixern (förbuffring och schemaläggning), -1 innan dess
+  float first_sample_ms() const noexcept;
+
+  struct impl;
+
+private:
+  impl *impl_ = nullptr;
+};
+
+} // namespace audio
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 
+#include "audio/realtime.h"
 #include "audio/ring_buffer.h"
 
 namespace audio {
@@ -11,6 +12,12 @@ public:
     int sampleRate = 44100;
     int channels = 2;
     int framesPerBuffer = 512;
+    // PortAudio-enhetens index, -1 => standardutgången
+    int device = -1;
+    // CPU för callback-tråden, -1 => ingen låsning
+    int cpu = -1;
+    // resultat av trådinställningarna, kan vara nullptr
+    rt_status *status = nullptr;
   };
 
   port_audio_output();
@@ -19,6 +26,9 @@ public:
   void start(ring_buffer &rb, const config &cfg);
   void stop();
 
+  // Fördröjning efter ringbufferten enligt PortAudio, 0 när den inte går
+  float output_latency_ms() const;
+
   struct impl;
 
 private:
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+namespace audio {
+
+// Realtidsmiljö för ljudtrådarna. Varje steg är frivilligt och misslyckas
+// tyst (resultatet sparas i rt_status) när rättigheter saknas, t.ex.
+// SCHED_FIFO utan CAP_SYS_NICE eller mlockall över RLIMIT_MEMLOCK.
+
+enum class rt_result : int {
+  off = 0,         // inte begärt
+  ok = 1,
+  denied = 2,      // EPERM/ENOMEM, kör vidare utan
+  unsupported = 3, // plattformen saknar stödet
+  failed = 4,
+};
+
+const char *to_string(rt_result r);
+
+struct rt_config {
+  int priority = 0;        // 1-99, 0 => normal schemaläggning
+  bool round_robin = false; // SCHED_RR i stället för SCHED_FIFO
+  int dsp_cpu = -1;        // -1 => ingen låsning till CPU
+  int output_cpu = -1;
+  bool lock_memory = false; // mlockall + förfelning av stacken
+};
+
+// Skrivs av respektive tråd när den konfigureras, läses av /health.
+struct rt_status {
+  std::atomic<int> dsp_sched{0};
+  std::atomic<int> dsp_affinity{0};
+  std::atomic<int> dsp_denormals{0};
+  std::atomic<int> output_sched{0};
+  std::atomic<int> output_affinity{0};
+  std::atomic<int> output_denormals{0};
+  std::atomic<int> memory_lock{0};
+};
+
+// Anropande tråd
+rt_result set_thread_priority(int priority, bool round_robin);
+rt_result pin_thread_to_cpu(int cpu);
+// FTZ/DAZ (x86) resp. FZ (ARM64). Gäller bara anropande tråd.
+rt_result flush_denormals();
+
+rt_result lock_memory();
+// Rör varje sida i [p, p + bytes) så att första åtkomsten i ljudtråden
+// inte ger en sidfel.
+void prefault(void *p, size_t bytes);
+void prefault_stack(size_t bytes = 256 * 1024);
+
+// Sätter upp anropande tråd som DSP-tråd enligt cfg och låser minnet.
+void setup_dsp_thread(const rt_config &cfg, rt_status &status);
+
+// "nyckel: värde"-rader för /health
+std::string describe(const rt_status &status);
+
+} // namespace audio
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace audio {
+
+// Minimal RTP (RFC 3550) för L16-ljud (RFC 3551). Nyttolasten är 16-bitars
+// big-endian PCM, interleaved. Timestamp räknas i frames.
+//
+// Sändaren lägger till en header extension (RFC 3550 5.3.1, profil 'SP')
+// med väggklockan (CLOCK_REALTIME, ns) då paketets första frame hörs i
+// sändarens eget rum. Mottagarna spelar den vid samma klockslag, så alla rum
+// ligger i fas om maskinernas klockor är synkade (NTP/PTP).
+
+constexpr size_t rtp_header_size = 12;
+constexpr size_t rtp_max_packet = 1500;
+constexpr uint16_t rtp_wallclock_profile = 0x5350;
+constexpr size_t rtp_wallclock_ext_size = 12; // profil, längd, 64 bitar
+
+struct rtp_header {
+  uint8_t payload_type = 0;
+  bool marker = false;
+  uint16_t seq = 0;
+  uint32_t timestamp = 0;
+  uint32_t ssrc = 0;
+  bool has_wallclock = false;
+  uint64_t wallclock_ns = 0;
+};
+
+inline uint64_t wallclock_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+// Statiska nyttolasttyper finns bara för 44.1 kHz, annars dynamisk (96).
+inline uint8_t rtp_payload_type(int sample_rate, int channels) {
+  if (sample_rate == 44100 && channels == 2)
+    return 10;
+  if (sample_rate == 44100 && channels == 1)
+    return 11;
+  return 96;
+}
+
+// Returnerar headerns längd, där nyttolasten börjar
+inline size_t write_rtp_header(uint8_t *p, const rtp_header &h) {
+  p[0] = h.has_wallclock ? 0x90 : 0x80; // V=2, ingen padding, CC=0
+  p[1] = static_cast<uint8_t>((h.marker ? 0x80 : 0x00) |
+                              (h.payload_type & 0x7f));
+  p[2] = static_cast<uint8_t>(h.seq >> 8);
+  p[3] = static_cast<uint8_t>(h.seq);
+  for (int i = 0; i < 4; ++i) {
+    p[4 + i] = static_cast<uint8_t>(h.timestamp >> (24 - 8 * i));
+    p[8 + i] = static_cast<uint8_t>(h.ssrc >> (24 - 8 * i));
+  }
+  if (!h.has_wallclock)
+    return rtp_header_size;
+
+  uint8_t *x = p + rtp_header_size;
+  x[0] = static_cast<uint8_t>(rtp_wallclock_profile >> 8);
+  x[1] = static_cast<uint8_t>(rtp_wallclock_profile);
+  x[2] = 0;
+  x[3] = 2; // längd i 32-bitarsord
+  for (int i = 0; i < 8; ++i)
+    x[4 + i] = static_cast<uint8_t>(h.wallclock_ns >> (56 - 8 * i));
+  return rtp_header_size + rtp_wallclock_ext_size;
+}
+
+// Returnerar false för paket som inte är giltig RTP v2. payload_offset hoppar
+// över CSRC-lista och header extension.
+inline bool read_rtp_header(const uint8_t *p, size_t len, rtp_header &h,
+                            size_t &payload_offset) {
+  if (len < rtp_header_size || (p[0] >> 6) != 2)
+    return false;
+
+  const size_t cc = p[0] & 0x0f;
+  size_t off = rtp_header_size + 4 * cc;
+  h.has_wallclock = false;
+  h.wallclock_ns = 0;
+  if (p[0] & 0x10) {
+    if (len < off + 4)
+      return false;
+    const uint16_t profile =
+        static_cast<uint16_t>((p[off] << 8) | p[off + 1]);
+    const size_t ext_words = (static_cast<size_t>(p[off + 2]) << 8) | p[off + 3];
+    if (profile == rtp_wallclock_profile && ext_words >= 2 &&
+        len >= off + rtp_wallclock_ext_size) {
+      h.has_wallclock = true;
+      for (int i = 0; i < 8; ++i)
+        h.wallclock_ns = (h.wallclock_ns << 8) | p[off + 4 + i];
+    }
+    off += 4 + 4 * ext_words;
+  }
+  size_t end = len;
+  if (p[0] & 0x20) {
+    const size_t pad = p[len - 1];
+    if (pad > len)
+      return false;
+    end -= pad;
+  }
+  if (off > end)
+    return false;
+
+  h.marker = (p[1] & 0x80) != 0;
+  h.payload_type = p[1] & 0x7f;
+  h.seq = static_cast<uint16_t>((p[2] << 8) | p[3]);
+  h.timestamp = 0;
+  h.ssrc = 0;
+  for (int i = 0; i < 4; ++i) {
+    h.timestamp = (h.timestamp << 8) | p[4 + i];
+    h.ssrc = (h.ssrc << 8) | p[8 + i];
+  }
+  payload_offset = off;
+  return true;
+}
+
+// Räknare för kontroll-API:t. Skrivs av nätverkstråden, läses av vem som helst.
+struct rtp_stats {
+  std::atomic<uint64_t> packets{0}; // skickade resp. mottagna
+  std::atomic<uint64_t> packets_lost{0};
+  std::atomic<uint64_t> packets_late{0};
+  std::atomic<uint64_t> underruns{0}; // mottagare: uppspelning gick tom
+  std::atomic<uint64_t> overruns{0};  // sändare: kön full, block tappat
+  std::atomic<float> latency_ms{0.0f}; // uppspelningsbuffertens djup
+  std::atomic<float> jitter_ms{0.0f};  // RFC 3550 interarrival jitter
+  std::atomic<float> drift_ppm{0.0f};  // aktuell resamplingskorrektion
+  // mottagare: uppspelningen följer sändarens väggklocka, och hur långt
+  // efter (+) eller före målet den ligger
+  std::atomic<bool> clock_anchored{false};
+  std::atomic<float> sync_error_ms{0.0f};
+};
+
+} // namespace audio
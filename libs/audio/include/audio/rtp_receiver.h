@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+
+#include "audio/realtime.h"
+#include "audio/ring_buffer.h"
+#include "audio/rtp.h"
+
+namespace audio {
+
+// Tar emot en ström från rtp_sender och matar en ring_buffer som spelas av
+// port_audio_output. Paket sorteras i en jitterbuffert, förlorade paket
+// ersätts med tystnad och sändarens klocka följs genom att resampla. Varje
+// paket ska höras vid klockslaget i paketet (rtp.h), samtidigt som i
+// sändarens rum; saknas klockan, eller går den inte att hinna med
+// (osynkade maskiner), hålls bufferten i stället runt latencyMs.
+class rtp_receiver {
+public:
+  struct config {
+    int port = 5004;
+    std::string group; // multicast-grupp, tom => unicast
+    int sampleRate = 44100;
+    int channels = 2;
+    float latencyMs = 60.0f;
+    // utgångens egen fördröjning efter ringbufferten, räknas bort från
+    // klockslaget
+    float outputLatencyMs = 0.0f;
+    // mottagartråden sätts upp som DSP-tråd (prioritet, --dsp-cpu, mlock);
+    // utan status bara denormaler
+    rt_config rt;
+    rt_status *status = nullptr;
+  };
+
+  rtp_receiver();
+  ~rtp_receiver();
+
+  void start(ring_buffer &rb, const config &cfg);
+  void stop();
+
+  const rtp_stats &stats() const;
+
+  struct impl;
+
+private:
+  impl *impl_ = nullptr;
+};
+
+} // namespace audio
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+
+#include "audio/rtp.h"
+
+namespace audio {
+
+// Paketerar bearbetat ljud till RTP/UDP, unicast eller multicast. push()
+// anropas från producer-tråden och lägger bara samples i en kö; en egen tråd
+// gör paketering och sendto().
+class rtp_sender {
+public:
+  struct config {
+    std::string host = "239.255.77.77";
+    int port = 5004;
+    int sampleRate = 44100;
+    int channels = 2;
+    int framesPerPacket = 256;
+    int multicastTtl = 1;
+  };
+
+  rtp_sender();
+  ~rtp_sender();
+
+  void start(const config &cfg);
+  void stop();
+
+  // Blockerar aldrig. Om sändtråden inte hinner med tappas samples.
+  // play_wall_ns: väggklockan (rtp.h) då första framen hörs lokalt, 0 =>
+  // okänd, paketen stämplas då med sändtiden.
+  void push(const float *interleaved, size_t frames,
+            uint64_t play_wall_ns = 0) noexcept;
+
+  const rtp_stats &stats() const;
+
+  struct impl;
+
+private:
+  impl *impl_ = nullptr;
+};
+
+} // namespace audio
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace audio {
+
+// Sampleformat på ingången (stdin), little-endian. Namnen följer
+// librespot --format.
+enum class sample_format {
+  s16,   // S16
+  s24,   // S24, 24 bitar i 32-bitarsord
+  s24_3, // S24_3, packade 3 byte
+  s32,   // S32
+  f32,   // F32
+};
+
+// "S16", "s24_3", ... Kastar std::runtime_error vid okänt namn.
+sample_format parse_sample_format(const std::string &name);
+const char *to_string(sample_format f);
+size_t bytes_per_sample(sample_format f);
+
+// Konverterar samples värden till float i [-1, 1).
+void to_float(const void *in, float *out, size_t samples, sample_format f);
+
+} // namespace audio
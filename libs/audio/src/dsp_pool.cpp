@@ -0,0 +1,147 @@
+#include "audio/dsp_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace audio {
+
+struct dsp_pool::impl {
+  std::vector<job *> jobs;
+  std::unique_ptr<std::atomic<bool>[]> busy;
+  std::unique_ptr<bool[]> ran; // skyddas av busy
+  std::vector<std::thread> threads;
+  std::atomic<bool> running{false};
+  int n_threads = 0;
+  uint64_t steal_slack_ns = 0;
+  std::atomic<uint64_t> late{0};
+  std::atomic<uint64_t> steals{0};
+};
+
+namespace {
+
+uint64_t now_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Tidigast deadline bland lediga jobb; egna jobb alltid, andras bara när
+// de är bråttom. -1 => inget att göra.
+int pick(dsp_pool::impl &p, int self, uint64_t now, uint64_t &deadline,
+         bool &stolen) {
+  int best = -1;
+  deadline = dsp_pool::not_ready;
+  stolen = false;
+
+  const int n = static_cast<int>(p.jobs.size());
+  for (int i = 0; i < n; i++) {
+    if (i % p.n_threads != self || p.busy[i].load(std::memory_order_relaxed))
+      continue;
+    const uint64_t d = p.jobs[i]->deadline_ns(now);
+    if (d < deadline) {
+      deadline = d;
+      best = i;
+    }
+  }
+  if (best >= 0)
+    return best;
+
+  const uint64_t urgent = now + p.steal_slack_ns;
+  for (int i = 0; i < n; i++) {
+    if (i % p.n_threads == self || p.busy[i].load(std::memory_order_relaxed))
+      continue;
+    const uint64_t d = p.jobs[i]->deadline_ns(now);
+    if (d < urgent && d < deadline) {
+      deadline = d;
+      best = i;
+      stolen = true;
+    }
+  }
+  return best;
+}
+
+void worker(dsp_pool::impl &p, int self, std::function<void(int)> init) {
+  if (init)
+    init(self);
+
+  while (p.running.load(std::memory_order_relaxed)) {
+    const uint64_t now = now_ns();
+    uint64_t deadline = 0;
+    bool stolen = false;
+    const int i = pick(p, self, now, deadline, stolen);
+
+    // Inget får plats: vänta som den gamla producentloopen på full buffert
+    if (i < 0 || p.busy[i].exchange(true, std::memory_order_acquire)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      continue;
+    }
+
+    // före första blocket är utgången tom av naturliga skäl
+    if (deadline <= now && p.ran[i])
+      p.late.fetch_add(1, std::memory_order_relaxed);
+    p.ran[i] = true;
+    if (stolen)
+      p.steals.fetch_add(1, std::memory_order_relaxed);
+
+    p.jobs[i]->run();
+    p.busy[i].store(false, std::memory_order_release);
+  }
+}
+
+} // namespace
+
+dsp_pool::dsp_pool() : impl_(new impl()) {}
+
+dsp_pool::~dsp_pool() {
+  stop();
+  delete impl_;
+}
+
+void dsp_pool::add(job *j) {
+  if (impl_->running.load())
+    throw std::runtime_error("dsp_pool: add after start");
+  impl_->jobs.push_back(j);
+}
+
+void dsp_pool::start(const config &cfg) {
+  if (impl_->running.exchange(true))
+    return;
+
+  impl_->n_threads = cfg.threads < 1 ? 1 : cfg.threads;
+  impl_->steal_slack_ns =
+      static_cast<uint64_t>(cfg.steal_slack_ms * 1'000'000.0f);
+  impl_->busy.reset(new std::atomic<bool>[impl_->jobs.size()]);
+  impl_->ran.reset(new bool[impl_->jobs.size()]());
+  for (size_t i = 0; i < impl_->jobs.size(); i++)
+    impl_->busy[i].store(false);
+
+  for (int t = 0; t < impl_->n_threads; t++) {
+    impl_->threads.emplace_back(worker, std::ref(*impl_), t, cfg.thread_init);
+  }
+}
+
+void dsp_pool::stop() {
+  impl_->running.store(false);
+  for (std::thread &t : impl_->threads) {
+    if (t.joinable())
+      t.join();
+  }
+  impl_->threads.clear();
+}
+
+uint64_t dsp_pool::late() const noexcept {
+  return impl_->late.load(std::memory_order_relaxed);
+}
+
+uint64_t dsp_pool::steals() const noexcept {
+  return impl_->steals.load(std::memory_order_relaxed);
+}
+
+int dsp_pool::threads() const noexcept { return impl_->n_threads; }
+
+} // namespace audio
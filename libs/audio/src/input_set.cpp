@@ -0,0 +1,179 @@
+#include "audio/input_set.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace audio {
+
+input_set::input_set() {
+  // Städar bort färdiga källor (t.ex. en uppspelad ringklocka) och raderar
+  // borttagna när ljudtråden har släppt dem.
+  reaper_ = std::thread([this] {
+    while (running_.load(std::memory_order_relaxed)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      reap();
+    }
+  });
+}
+
+input_set::~input_set() {
+  running_.store(false);
+  if (reaper_.joinable())
+    reaper_.join();
+
+  // ljudtråden har stannat när input_set förstörs
+  for (slot &s : slots_)
+    delete s.src.exchange(nullptr);
+  for (const retired &r : retired_)
+    delete r.src;
+}
+
+int input_set::add(std::unique_ptr<input_source> src, const params &p,
+                   bool primary) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  int free_slot = -1;
+  for (int i = 0; i < max_inputs; ++i) {
+    input_source *s = slots_[i].src.load();
+    if (s && s->cfg().name == src->cfg().name)
+      throw std::runtime_error("input exists: " + src->cfg().name);
+    if (!s && free_slot < 0)
+      free_slot = i;
+  }
+  if (free_slot < 0)
+    throw std::runtime_error("no free input slot");
+
+  slot &s = slots_[free_slot];
+  s.gain_db.store(p.gain_db);
+  s.priority.store(p.priority);
+  s.duck_db.store(p.duck_db);
+  s.primary.store(primary);
+  s.generation.fetch_add(1);
+  s.src.store(src.release());
+  return free_slot;
+}
+
+void input_set::detach(int i) {
+  input_source *src = slots_[i].src.exchange(nullptr);
+  if (!src)
+    return;
+  src->stop();
+  retired_.push_back({src, epoch_.load()});
+}
+
+bool input_set::remove(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < max_inputs; ++i) {
+    input_source *s = slots_[i].src.load();
+    if (s && s->cfg().name == name) {
+      detach(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool input_set::update(const std::string &name, const params &p) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (slot &s : slots_) {
+    input_source *src = s.src.load();
+    if (src && src->cfg().name == name) {
+      s.gain_db.store(p.gain_db);
+      s.priority.store(p.priority);
+      s.duck_db.store(p.duck_db);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool input_set::find(const std::string &name, params &p) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const slot &s : slots_) {
+    input_source *src = s.src.load();
+    if (src && src->cfg().name == name) {
+      p.gain_db = s.gain_db.load();
+      p.priority = s.priority.load();
+      p.duck_db = s.duck_db.load();
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<input_set::info> input_set::list() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<info> out;
+  for (int i = 0; i < max_inputs; ++i) {
+    const slot &s = slots_[i];
+    input_source *src = s.src.load();
+    if (!src)
+      continue;
+    info in;
+    in.slot = i;
+    in.name = src->cfg().name;
+    in.source = src->cfg().type == input_source::kind::capture
+                    ? "capture"
+                    : src->cfg().path;
+    in.p.gain_db = s.gain_db.load();
+    in.p.priority = s.priority.load();
+    in.p.duck_db = s.duck_db.load();
+    in.primary = s.primary.load();
+    in.playing = src->playing();
+    in.underruns = src->underruns();
+    in.connected = src->connected();
+    in.reconnects = src->reconnects();
+    in.first_sample_ms = src->first_sample_ms();
+    out.push_back(std::move(in));
+  }
+  return out;
+}
+
+bool input_set::primary_finished() const noexcept {
+  for (const slot &s : slots_) {
+    input_source *src = s.src.load(std::memory_order_acquire);
+    if (src && s.primary.load(std::memory_order_relaxed) && src->finished())
+      return true;
+  }
+  return false;
+}
+
+void input_set::reap() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < max_inputs; ++i) {
+    input_source *src = slots_[i].src.load();
+    if (src && !slots_[i].primary.load() && src->finished())
+      detach(i);
+  }
+
+  const uint64_t now = epoch_.load();
+  std::erase_if(retired_, [now](const retired &r) {
+    if (now <= r.epoch)
+      return false;
+    delete r.src;
+    return true;
+  });
+}
+
+input_set::block input_set::pull(int i, float *out, size_t frames) noexcept {
+  block b;
+  slot &s = slots_[i];
+  input_source *src = s.src.load(std::memory_order_acquire);
+  if (!src)
+    return b;
+
+  const uint32_t gen = s.generation.load(std::memory_order_relaxed);
+  b.present = true;
+  b.restart = gen != s.seen_generation;
+  s.seen_generation = gen;
+
+  b.p.gain_db = s.gain_db.load(std::memory_order_relaxed);
+  b.p.priority = s.priority.load(std::memory_order_relaxed);
+  b.p.duck_db = s.duck_db.load(std::memory_order_relaxed);
+  b.frames = src->pull(out, frames);
+  return b;
+}
+
+void input_set::end_block() noexcept { epoch_.fetch_add(1); }
+
+} // namespace audio
@@ -1,8 +1,14 @@
 #include "audio/port_audio_output.h"
 #include "audio/ring_buffer.h"
 
+#include "rt_check/rt_check.h"
+#include "trace/trace.h"
+
+#include <atomic>
+#include <pthread.h>
 #include <portaudio.h>
 #include <stdexcept>
+#include <string>
 
 namespace audio {
 
@@ -10,23 +16,61 @@ struct port_audio_output::impl {
   ring_buffer *rb = nullptr;
   config cfg{};
   PaStream *stream = nullptr;
+  std::atomic<bool> thread_ready{false};
+  // spårbuffert för callback-trådarna, reserveras av första start()
+  int trace_slot = -1;
 };
 
+// Callback-tråden skapas av PortAudio, så den ställs in vid första anropet.
+// Schemaläggningen lämnas åt PortAudio (ALSA/CoreAudio sätter redan RT-
+// prioritet när det går); här läses bara resultatet av.
+static void setup_callback_thread(port_audio_output::impl *impl) {
+  const rt_result denormals = flush_denormals();
+  const rt_result affinity = pin_thread_to_cpu(impl->cfg.cpu);
+  trace::attach_thread(impl->trace_slot);
+
+  if (rt_status *st = impl->cfg.status) {
+    st->output_denormals.store(static_cast<int>(denormals));
+    st->output_affinity.store(static_cast<int>(affinity));
+
+    int policy = 0;
+    sched_param sp{};
+    if (pthread_getschedparam(pthread_self(), &policy, &sp) == 0) {
+      const bool rt = policy == SCHED_FIFO || policy == SCHED_RR;
+      st->output_sched.store(
+          static_cast<int>(rt ? rt_result::ok : rt_result::off));
+    }
+  }
+}
+
 static int callback(const void *, void *output, unsigned long frameCount,
                     const PaStreamCallbackTimeInfo *, PaStreamCallbackFlags,
                     void *userData) {
   auto *impl = static_cast<port_audio_output::impl *>(userData);
   float *out = static_cast<float *>(output);
 
+  rt_check::realtime_scope rt;
+  if (!impl->thread_ready.load(std::memory_order_relaxed)) {
+    setup_callback_thread(impl);
+    impl->thread_ready.store(true, std::memory_order_relaxed);
+  }
+
+  trace::scope t("callback");
+
   const unsigned long total =
       frameCount * static_cast<unsigned long>(impl->cfg.channels);
+  bool underrun = false;
   for (unsigned long i = 0; i < total; ++i) {
     float s;
-    if (impl->rb->pop(s))
+    if (impl->rb->pop(s)) {
       out[i] = s;
-    else
+    } else {
       out[i] = 0.0f; // underrun => silence
+      underrun = true;
+    }
   }
+  if (underrun)
+    trace::instant("underrun");
   return paContinue;
 }
 
@@ -43,22 +87,52 @@ port_audio_output::~port_audio_output() {
 void port_audio_output::start(ring_buffer &rb, const config &cfg) {
   impl_->rb = &rb;
   impl_->cfg = cfg;
+  impl_->thread_ready.store(false);
+  if (impl_->trace_slot < 0)
+    impl_->trace_slot = trace::reserve_thread("portaudio");
 
   PaError e = Pa_Initialize();
   if (e != paNoError)
     throw std::runtime_error("Pa_Initialize failed");
 
-  e = Pa_OpenDefaultStream(&impl_->stream, 0, cfg.channels, paFloat32,
-                           cfg.sampleRate, cfg.framesPerBuffer, callback,
-                           impl_);
-  if (e != paNoError)
-    throw std::runtime_error("Pa_OpenDefaultStream failed");
+  if (cfg.device < 0) {
+    e = Pa_OpenDefaultStream(&impl_->stream, 0, cfg.channels, paFloat32,
+                             cfg.sampleRate, cfg.framesPerBuffer, callback,
+                             impl_);
+    if (e != paNoError)
+      throw std::runtime_error("Pa_OpenDefaultStream failed");
+  } else {
+    const PaDeviceInfo *info = cfg.device < Pa_GetDeviceCount()
+                                   ? Pa_GetDeviceInfo(cfg.device)
+                                   : nullptr;
+    if (!info)
+      throw std::runtime_error("no such output device " +
+                               std::to_string(cfg.device));
+
+    PaStreamParameters out{};
+    out.device = cfg.device;
+    out.channelCount = cfg.channels;
+    out.sampleFormat = paFloat32;
+    out.suggestedLatency = info->defaultLowOutputLatency;
+    e = Pa_OpenStream(&impl_->stream, nullptr, &out, cfg.sampleRate,
+                      cfg.framesPerBuffer, paNoFlag, callback, impl_);
+    if (e != paNoError)
+      throw std::runtime_error(std::string("Pa_OpenStream failed: ") +
+                               info->name);
+  }
 
   e = Pa_StartStream(impl_->stream);
   if (e != paNoError)
     throw std::runtime_error("Pa_StartStream failed");
 }
 
+float port_audio_output::output_latency_ms() const {
+  if (!impl_->stream)
+    return 0.0f;
+  const PaStreamInfo *info = Pa_GetStreamInfo(impl_->stream);
+  return info ? static_cast<float>(1000.0 * info->outputLatency) : 0.0f;
+}
+
 void port_audio_output::stop() {
   if (impl_->stream) {
     Pa_StopStream(impl_->stream);
@@ -0,0 +1,141 @@
+#include "audio/realtime.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+namespace audio {
+
+const char *to_string(rt_result r) {
+  switch (r) {
+  case rt_result::off:
+    return "off";
+  case rt_result::ok:
+    return "ok";
+  case rt_result::denied:
+    return "denied";
+  case rt_result::unsupported:
+    return "unsupported";
+  case rt_result::failed:
+    return "failed";
+  }
+  return "unknown";
+}
+
+rt_result set_thread_priority(int priority, bool round_robin) {
+  if (priority <= 0)
+    return rt_result::off;
+
+  const int policy = round_robin ? SCHED_RR : SCHED_FIFO;
+  sched_param sp{};
+  sp.sched_priority = priority;
+  const int min = sched_get_priority_min(policy);
+  const int max = sched_get_priority_max(policy);
+  if (sp.sched_priority < min)
+    sp.sched_priority = min;
+  if (sp.sched_priority > max)
+    sp.sched_priority = max;
+
+  const int e = pthread_setschedparam(pthread_self(), policy, &sp);
+  if (e == 0)
+    return rt_result::ok;
+  return e == EPERM ? rt_result::denied : rt_result::failed;
+}
+
+rt_result pin_thread_to_cpu(int cpu) {
+  if (cpu < 0)
+    return rt_result::off;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  const int e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (e == 0)
+    return rt_result::ok;
+  return e == EPERM ? rt_result::denied : rt_result::failed;
+#else
+  return rt_result::unsupported;
+#endif
+}
+
+rt_result flush_denormals() {
+#if defined(__x86_64__) || defined(__i386__)
+  // FTZ (bit 15) + DAZ (bit 6)
+  _mm_setcsr(_mm_getcsr() | 0x8040);
+  return rt_result::ok;
+#elif defined(__aarch64__)
+  uint64_t fpcr;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+  fpcr |= (1ull << 24); // FZ
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+  return rt_result::ok;
+#else
+  return rt_result::unsupported;
+#endif
+}
+
+rt_result lock_memory() {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+    return rt_result::ok;
+  return (errno == EPERM || errno == ENOMEM) ? rt_result::denied
+                                             : rt_result::failed;
+}
+
+void prefault(void *p, size_t bytes) {
+  constexpr size_t page = 4096;
+  volatile unsigned char *b = static_cast<volatile unsigned char *>(p);
+  for (size_t i = 0; i < bytes; i += page)
+    b[i] = b[i];
+  if (bytes > 0)
+    b[bytes - 1] = b[bytes - 1];
+}
+
+void prefault_stack(size_t bytes) {
+  // Växer stacken en gång i förväg; med mlockall(MCL_FUTURE) blir den kvar
+  volatile unsigned char *buf =
+      static_cast<volatile unsigned char *>(__builtin_alloca(bytes));
+  for (size_t i = 0; i < bytes; i += 4096)
+    buf[i] = 0;
+}
+
+void setup_dsp_thread(const rt_config &cfg, rt_status &status) {
+  status.dsp_denormals.store(static_cast<int>(flush_denormals()));
+  status.dsp_sched.store(
+      static_cast<int>(set_thread_priority(cfg.priority, cfg.round_robin)));
+  status.dsp_affinity.store(static_cast<int>(pin_thread_to_cpu(cfg.dsp_cpu)));
+
+  if (cfg.lock_memory) {
+    // Allt som redan är allokerat (fördröjningslinjer, ringbuffert) låses
+    // och görs resident av MCL_CURRENT; stacken förfelas explicit.
+    const rt_result r = lock_memory();
+    status.memory_lock.store(static_cast<int>(r));
+    prefault_stack();
+  }
+}
+
+std::string describe(const rt_status &status) {
+  auto s = [](const std::atomic<int> &v) {
+    return to_string(static_cast<rt_result>(v.load()));
+  };
+
+  std::ostringstream os;
+  os << "rt_dsp_sched: " << s(status.dsp_sched) << "\n";
+  os << "rt_dsp_affinity: " << s(status.dsp_affinity) << "\n";
+  os << "rt_dsp_denormals: " << s(status.dsp_denormals) << "\n";
+  os << "rt_output_sched: " << s(status.output_sched) << "\n";
+  os << "rt_output_affinity: " << s(status.output_affinity) << "\n";
+  os << "rt_output_denormals: " << s(status.output_denormals) << "\n";
+  os << "rt_memory_lock: " << s(status.memory_lock) << "\n";
+  return os.str();
+}
+
+} // namespace audio
@@ -0,0 +1,353 @@
+#include "audio/rtp_receiver.h"
+#include "audio/realtime.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace audio {
+
+namespace {
+
+// Antal paketplatser i jitterbufferten och hur långt fram ett paket får
+// komma innan luckan framför det räknas som förlorad.
+constexpr size_t slot_count = 64;
+constexpr int reorder_window = 4;
+
+struct slot {
+  bool valid = false;
+  uint16_t seq = 0;
+  size_t samples = 0;
+  uint64_t wall_ns = 0; // 0 => sändaren skickade ingen klocka
+  std::array<float, rtp_max_packet / 2> data{};
+};
+
+} // namespace
+
+struct rtp_receiver::impl {
+  ring_buffer *rb = nullptr;
+  config cfg{};
+  int sock = -1;
+
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  std::vector<slot> slots = std::vector<slot>(slot_count);
+  bool synced = false;
+  uint16_t next_seq = 0;
+  uint32_t ssrc = 0;
+  size_t last_samples = 0;
+  uint64_t next_wall_ns = 0; // väntad klocka för nästa paket, till förluster
+
+  // RFC 3550 jitter, i frames
+  bool have_transit = false;
+  double prev_arrival = 0.0;
+  uint32_t prev_timestamp = 0;
+  double jitter = 0.0;
+
+  // drift: linjär resampling styrd av buffertnivån mot målet
+  double ratio = 1.0;
+  double integral = 0.0;
+  double fill_avg = 0.0;
+  double err_avg = 0.0; // frames, + => spelas för sent
+  bool anchored = false;
+  double phase = 0.0;
+  std::vector<float> prev;
+  std::vector<float> frame;
+
+  rtp_stats stats;
+
+  size_t target_frames() const {
+    return static_cast<size_t>(cfg.latencyMs * 0.001f *
+                               static_cast<float>(cfg.sampleRate));
+  }
+
+  // Antal frames som ska ligga före ett paket med klockan wall_ns för att
+  // det ska höras i tid, eller den fasta nivån när det inte går
+  double target_for(uint64_t wall_ns, bool &ok) const {
+    const double latency = static_cast<double>(target_frames());
+    ok = false;
+    if (wall_ns == 0)
+      return latency;
+    const double ahead_s =
+        static_cast<double>(static_cast<int64_t>(wall_ns - wallclock_ns())) *
+            1e-9 -
+        cfg.outputLatencyMs * 1e-3;
+    const double t = ahead_s * cfg.sampleRate;
+    const double room =
+        static_cast<double>(rb->capacity() / static_cast<size_t>(cfg.channels));
+    if (t < 0.0 || t > room)
+      return latency;
+    ok = true;
+    return t;
+  }
+
+  void prime(double target) {
+    // Fyll upp till målnivån med tystnad så att servot startar i balans
+    const size_t ch = static_cast<size_t>(cfg.channels);
+    const size_t want = static_cast<size_t>(target) * ch;
+    while (rb->count() < want && rb->push(0.0f)) {
+    }
+    fill_avg = target;
+    err_avg = 0.0;
+  }
+
+  void push_frame(const float *x) {
+    const size_t ch = static_cast<size_t>(cfg.channels);
+    while (phase < 1.0) {
+      for (size_t c = 0; c < ch; ++c) {
+        frame[c] = prev[c] + (x[c] - prev[c]) * static_cast<float>(phase);
+      }
+      if (rb->capacity() - rb->count() >= ch) {
+        for (size_t c = 0; c < ch; ++c)
+          rb->push(frame[c]);
+      }
+      phase += ratio;
+    }
+    phase -= 1.0;
+    std::copy(x, x + ch, prev.begin());
+  }
+
+  void play(const float *samples, size_t count, uint64_t wall_ns) {
+    const size_t ch = static_cast<size_t>(cfg.channels);
+
+    bool ok = false;
+    const double target = target_for(wall_ns, ok);
+    if (ok != anchored) {
+      anchored = ok;
+      err_avg = 0.0;
+    }
+    if (wall_ns != 0)
+      next_wall_ns = wall_ns + static_cast<uint64_t>(
+                                   1e9 * static_cast<double>(count / ch) /
+                                   cfg.sampleRate);
+
+    if (rb->count() < ch) {
+      stats.underruns.fetch_add(1, std::memory_order_relaxed);
+      prime(target);
+    }
+
+    // PI-regulator på avståndet mellan buffertnivån och målet. Med klockan
+    // tar ankomsttiden ut sig: ett sent paket möter en tömdare buffert men
+    // också ett närmare mål. Integraldelen hittar den faktiska
+    // klockskillnaden, P-delen tar hand om snabba avvikelser.
+    const double latency = static_cast<double>(target_frames());
+    const double fill = static_cast<double>(rb->count() / ch);
+    fill_avg += 0.05 * (fill - fill_avg);
+    err_avg += 0.05 * ((fill - target) - err_avg);
+    const double err = err_avg / std::max(latency, 1.0);
+    integral = std::clamp(integral + 5e-6 * err, -1e-3, 1e-3);
+    ratio = 1.0 + std::clamp(integral + 2e-3 * err, -2e-3, 2e-3);
+
+    for (size_t i = 0; i + ch <= count; i += ch)
+      push_frame(samples + i);
+
+    stats.latency_ms.store(static_cast<float>(1000.0 * fill_avg /
+                                              cfg.sampleRate),
+                           std::memory_order_relaxed);
+    stats.drift_ppm.store(static_cast<float>((ratio - 1.0) * 1e6),
+                          std::memory_order_relaxed);
+    stats.clock_anchored.store(anchored, std::memory_order_relaxed);
+    stats.sync_error_ms.store(
+        anchored ? static_cast<float>(1000.0 * err_avg / cfg.sampleRate)
+                 : 0.0f,
+        std::memory_order_relaxed);
+  }
+
+  void conceal() {
+    // Förlorat paket => tystnad av samma längd som föregående
+    static const std::array<float, rtp_max_packet / 2> silence{};
+    play(silence.data(), last_samples, next_wall_ns);
+    stats.packets_lost.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void release() {
+    while (true) {
+      slot &s = slots[next_seq % slot_count];
+      if (s.valid && s.seq == next_seq) {
+        play(s.data.data(), s.samples, s.wall_ns);
+        last_samples = s.samples;
+        s.valid = false;
+        ++next_seq;
+        continue;
+      }
+
+      // Har vi paket tillräckligt långt fram ger vi upp på luckan
+      bool ahead = false;
+      for (int d = reorder_window; d < static_cast<int>(slot_count); ++d) {
+        const uint16_t seq = static_cast<uint16_t>(next_seq + d);
+        const slot &a = slots[seq % slot_count];
+        if (a.valid && a.seq == seq) {
+          ahead = true;
+          break;
+        }
+      }
+      if (!ahead)
+        return;
+      conceal();
+      ++next_seq;
+    }
+  }
+
+  void on_packet(const uint8_t *p, size_t len) {
+    rtp_header h;
+    size_t off = 0;
+    if (!read_rtp_header(p, len, h, off))
+      return;
+    if (h.payload_type != rtp_payload_type(cfg.sampleRate, cfg.channels))
+      return;
+
+    const size_t ch = static_cast<size_t>(cfg.channels);
+    const size_t samples = (len - off) / 2;
+    if (samples == 0 || samples % ch != 0)
+      return;
+
+    // Ny sändare eller stort hopp => börja om
+    const int16_t delta = static_cast<int16_t>(h.seq - next_seq);
+    if (!synced || h.ssrc != ssrc || delta >= static_cast<int>(slot_count) ||
+        delta < -static_cast<int>(slot_count)) {
+      for (slot &s : slots)
+        s.valid = false;
+      synced = true;
+      ssrc = h.ssrc;
+      next_seq = h.seq;
+      next_wall_ns = 0;
+      have_transit = false;
+    } else if (delta < 0) {
+      stats.packets_late.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    const double arrival =
+        std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count() *
+        cfg.sampleRate;
+    if (have_transit) {
+      // Skillnad i transittid mellan två paket; timestamp-differensen tas
+      // modulo 2^32 så att wrap inte ger en spik.
+      const double d = std::fabs(
+          (arrival - prev_arrival) -
+          static_cast<double>(static_cast<int32_t>(h.timestamp -
+                                                   prev_timestamp)));
+      jitter += (d - jitter) / 16.0;
+      stats.jitter_ms.store(static_cast<float>(1000.0 * jitter /
+                                               cfg.sampleRate),
+                            std::memory_order_relaxed);
+    }
+    prev_arrival = arrival;
+    prev_timestamp = h.timestamp;
+    have_transit = true;
+
+    slot &s = slots[h.seq % slot_count];
+    s.valid = true;
+    s.seq = h.seq;
+    s.samples = samples;
+    s.wall_ns = h.has_wallclock ? h.wallclock_ns : 0;
+    const uint8_t *pl = p + off;
+    for (size_t i = 0; i < samples; ++i) {
+      const int16_t v =
+          static_cast<int16_t>((static_cast<uint16_t>(pl[2 * i]) << 8) |
+                               pl[2 * i + 1]);
+      s.data[i] = static_cast<float>(v) / 32768.0f;
+    }
+    stats.packets.fetch_add(1, std::memory_order_relaxed);
+
+    release();
+  }
+};
+
+rtp_receiver::rtp_receiver() : impl_(new impl()) {}
+
+rtp_receiver::~rtp_receiver() {
+  try {
+    stop();
+  } catch (...) {
+  }
+  delete impl_;
+}
+
+void rtp_receiver::start(ring_buffer &rb, const config &cfg) {
+  if (impl_->running.load())
+    return;
+
+  impl_->rb = &rb;
+  impl_->cfg = cfg;
+  impl_->prev.assign(static_cast<size_t>(cfg.channels), 0.0f);
+  impl_->frame.assign(static_cast<size_t>(cfg.channels), 0.0f);
+
+  impl_->sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (impl_->sock < 0)
+    throw std::runtime_error("rtp_receiver: socket failed");
+
+  const int reuse = 1;
+  setsockopt(impl_->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(static_cast<uint16_t>(cfg.port));
+  if (::bind(impl_->sock, reinterpret_cast<const sockaddr *>(&addr),
+             sizeof(addr)) != 0) {
+    ::close(impl_->sock);
+    impl_->sock = -1;
+    throw std::runtime_error("rtp_receiver: bind failed");
+  }
+
+  // Unicast-adresser (t.ex. 127.0.0.1:5004) tas emot på alla interface
+  ip_mreq mreq{};
+  if (!cfg.group.empty() &&
+      inet_pton(AF_INET, cfg.group.c_str(), &mreq.imr_multiaddr) == 1 &&
+      IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(impl_->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                   sizeof(mreq)) != 0) {
+      ::close(impl_->sock);
+      impl_->sock = -1;
+      throw std::runtime_error("rtp_receiver: join " + cfg.group + " failed");
+    }
+  }
+
+  impl_->running.store(true);
+  impl_->thread = std::thread([impl = impl_]() {
+    uint8_t packet[rtp_max_packet];
+    if (impl->cfg.status)
+      setup_dsp_thread(impl->cfg.rt, *impl->cfg.status);
+    else
+      flush_denormals();
+    while (impl->running.load(std::memory_order_relaxed)) {
+      pollfd pfd{impl->sock, POLLIN, 0};
+      if (::poll(&pfd, 1, 50) <= 0)
+        continue;
+      const ssize_t n = ::recv(impl->sock, packet, sizeof(packet), 0);
+      if (n > 0)
+        impl->on_packet(packet, static_cast<size_t>(n));
+    }
+  });
+}
+
+void rtp_receiver::stop() {
+  if (!impl_->running.exchange(false))
+    return;
+  if (impl_->thread.joinable())
+    impl_->thread.join();
+  if (impl_->sock >= 0) {
+    ::close(impl_->sock);
+    impl_->sock = -1;
+  }
+}
+
+const rtp_stats &rtp_receiver::stats() const { return impl_->stats; }
+
+} // namespace audio
@@ -0,0 +1,232 @@
+#include "audio/rtp_sender.h"
+#include "audio/realtime.h"
+#include "audio/ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace audio {
+
+struct rtp_sender::impl {
+  config cfg{};
+  int sock = -1;
+  sockaddr_in dest{};
+
+  std::unique_ptr<ring_buffer> queue;
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  uint16_t seq = 0;
+  uint32_t timestamp = 0;
+  uint32_t ssrc = 0;
+
+  // Senaste push(): frame-index i kön och när den hörs lokalt. Seqlock,
+  // udda seq medan push() skriver.
+  uint64_t pushed = 0; // endast producer
+  std::atomic<uint64_t> anchor_seq{0};
+  std::atomic<uint64_t> anchor_frame{0};
+  std::atomic<uint64_t> anchor_wall{0};
+
+  // Klockan för frame-index frame enligt senaste push(), 0 om okänd
+  uint64_t wall_for(uint64_t frame) const {
+    uint64_t s1, f, w;
+    do {
+      s1 = anchor_seq.load(std::memory_order_acquire);
+      f = anchor_frame.load(std::memory_order_relaxed);
+      w = anchor_wall.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((s1 & 1) || anchor_seq.load(std::memory_order_relaxed) != s1);
+    if (w == 0)
+      return 0;
+    const double d = static_cast<double>(static_cast<int64_t>(frame - f));
+    return w + static_cast<uint64_t>(
+                   static_cast<int64_t>(d * 1e9 / cfg.sampleRate));
+  }
+
+  rtp_stats stats;
+};
+
+static int16_t float_to_s16(float v) {
+  const float c = std::clamp(v, -1.0f, 1.0f);
+  return static_cast<int16_t>(std::lrint(c * 32767.0f));
+}
+
+rtp_sender::rtp_sender() : impl_(new impl()) {}
+
+rtp_sender::~rtp_sender() {
+  try {
+    stop();
+  } catch (...) {
+  }
+  delete impl_;
+}
+
+void rtp_sender::start(const config &cfg) {
+  if (impl_->running.load())
+    return;
+
+  const size_t payload_bytes = static_cast<size_t>(cfg.framesPerPacket) *
+                               static_cast<size_t>(cfg.channels) *
+                               sizeof(int16_t);
+  if (cfg.framesPerPacket <= 0 || cfg.channels <= 0 ||
+      rtp_header_size + rtp_wallclock_ext_size + payload_bytes >
+          rtp_max_packet)
+    throw std::runtime_error("rtp_sender: packet does not fit in MTU");
+
+  impl_->cfg = cfg;
+
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo *res = nullptr;
+  if (getaddrinfo(cfg.host.c_str(), nullptr, &hints, &res) != 0 || !res)
+    throw std::runtime_error("rtp_sender: cannot resolve " + cfg.host);
+  std::memcpy(&impl_->dest, res->ai_addr, sizeof(sockaddr_in));
+  freeaddrinfo(res);
+  impl_->dest.sin_port = htons(static_cast<uint16_t>(cfg.port));
+
+  impl_->sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (impl_->sock < 0)
+    throw std::runtime_error("rtp_sender: socket failed");
+
+  if (IN_MULTICAST(ntohl(impl_->dest.sin_addr.s_addr))) {
+    const unsigned char ttl = static_cast<unsigned char>(cfg.multicastTtl);
+    const unsigned char loop = 1; // låt mottagare på samma maskin höra
+    setsockopt(impl_->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(impl_->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop,
+               sizeof(loop));
+  }
+
+  std::random_device rd;
+  impl_->ssrc = rd();
+  impl_->seq = static_cast<uint16_t>(rd());
+  impl_->timestamp = rd();
+
+  // ~200 ms kö mellan producer och sändtråd
+  impl_->queue = std::make_unique<ring_buffer>(
+      static_cast<size_t>(cfg.sampleRate / 5) *
+      static_cast<size_t>(cfg.channels));
+
+  impl_->running.store(true);
+  impl_->thread = std::thread([impl = impl_]() {
+    flush_denormals();
+    const size_t samples_per_packet =
+        static_cast<size_t>(impl->cfg.framesPerPacket) *
+        static_cast<size_t>(impl->cfg.channels);
+    uint8_t packet[rtp_max_packet];
+    const uint8_t pt =
+        rtp_payload_type(impl->cfg.sampleRate, impl->cfg.channels);
+    const int64_t packet_ns = static_cast<int64_t>(
+        1e9 * impl->cfg.framesPerPacket / impl->cfg.sampleRate);
+    const size_t header_size = rtp_header_size + rtp_wallclock_ext_size;
+    bool first = true;
+    int64_t next_stamp = 0;
+    uint64_t sent = 0; // frames
+
+    while (impl->running.load(std::memory_order_relaxed)) {
+      if (impl->queue->count() < samples_per_packet) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+
+      uint8_t *payload = packet + header_size;
+      for (size_t i = 0; i < samples_per_packet; ++i) {
+        float s = 0.0f;
+        impl->queue->pop(s);
+        const uint16_t v = static_cast<uint16_t>(float_to_s16(s));
+        payload[2 * i] = static_cast<uint8_t>(v >> 8);
+        payload[2 * i + 1] = static_cast<uint8_t>(v);
+      }
+
+      rtp_header h;
+      h.payload_type = pt;
+      h.marker = first; // början av en talspurt enligt RFC 3551
+      h.seq = impl->seq++;
+      h.timestamp = impl->timestamp;
+      h.ssrc = impl->ssrc;
+      // När paketets första frame hörs lokalt. Uppskattningen hoppar med
+      // utgångens block, så den följs långsamt från förväntat värde; ett
+      // hopp (paus, klockjustering) börjar om.
+      const uint64_t play = impl->wall_for(sent);
+      const int64_t now =
+          static_cast<int64_t>(play ? play : wallclock_ns());
+      int64_t stamp = now;
+      if (!first && std::llabs(now - next_stamp) < 50'000'000)
+        stamp = next_stamp + (now - next_stamp) / 64;
+      next_stamp = stamp + packet_ns;
+      sent += static_cast<uint64_t>(impl->cfg.framesPerPacket);
+      h.has_wallclock = true;
+      h.wallclock_ns = static_cast<uint64_t>(stamp);
+      write_rtp_header(packet, h);
+      impl->timestamp += static_cast<uint32_t>(impl->cfg.framesPerPacket);
+      first = false;
+
+      const ssize_t n =
+          ::sendto(impl->sock, packet, header_size + 2 * samples_per_packet,
+                   0, reinterpret_cast<const sockaddr *>(&impl->dest),
+                   sizeof(impl->dest));
+      if (n >= 0)
+        impl->stats.packets.fetch_add(1, std::memory_order_relaxed);
+      else
+        impl->stats.packets_lost.fetch_add(1, std::memory_order_relaxed);
+
+      impl->stats.latency_ms.store(
+          1000.0f * static_cast<float>(impl->queue->count()) /
+              static_cast<float>(impl->cfg.channels * impl->cfg.sampleRate),
+          std::memory_order_relaxed);
+    }
+  });
+}
+
+void rtp_sender::stop() {
+  if (!impl_->running.exchange(false))
+    return;
+  if (impl_->thread.joinable())
+    impl_->thread.join();
+  if (impl_->sock >= 0) {
+    ::close(impl_->sock);
+    impl_->sock = -1;
+  }
+}
+
+void rtp_sender::push(const float *interleaved, size_t frames,
+                      uint64_t play_wall_ns) noexcept {
+  if (!impl_->running.load(std::memory_order_relaxed))
+    return;
+  const size_t samples = frames * static_cast<size_t>(impl_->cfg.channels);
+
+  // Hela blocket eller inget, annars hamnar kanalerna ur fas
+  if (impl_->queue->capacity() - impl_->queue->count() < samples) {
+    impl_->stats.overruns.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  for (size_t i = 0; i < samples; ++i)
+    impl_->queue->push(interleaved[i]);
+
+  const uint64_t s = impl_->anchor_seq.load(std::memory_order_relaxed);
+  impl_->anchor_seq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  impl_->anchor_frame.store(impl_->pushed, std::memory_order_relaxed);
+  impl_->anchor_wall.store(play_wall_ns, std::memory_order_relaxed);
+  impl_->anchor_seq.store(s + 2, std::memory_order_release);
+  impl_->pushed += frames;
+}
+
+const rtp_stats &rtp_sender::stats() const { return impl_->stats; }
+
+} // namespace audio
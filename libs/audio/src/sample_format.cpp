@@ -0,0 +1,104 @@
+#include "audio/sample_format.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace audio {
+
+sample_format parse_sample_format(const std::string &name) {
+  std::string n = name;
+  std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  if (n == "s16")
+    return sample_format::s16;
+  if (n == "s24")
+    return sample_format::s24;
+  if (n == "s24_3")
+    return sample_format::s24_3;
+  if (n == "s32")
+    return sample_format::s32;
+  if (n == "f32")
+    return sample_format::f32;
+  throw std::runtime_error("unknown sample format: " + name);
+}
+
+const char *to_string(sample_format f) {
+  switch (f) {
+  case sample_format::s16:
+    return "S16";
+  case sample_format::s24:
+    return "S24";
+  case sample_format::s24_3:
+    return "S24_3";
+  case sample_format::s32:
+    return "S32";
+  case sample_format::f32:
+    return "F32";
+  }
+  return "?";
+}
+
+size_t bytes_per_sample(sample_format f) {
+  switch (f) {
+  case sample_format::s16:
+    return 2;
+  case sample_format::s24_3:
+    return 3;
+  case sample_format::s24:
+  case sample_format::s32:
+  case sample_format::f32:
+    return 4;
+  }
+  return 2;
+}
+
+// memcpy per sample: bufferten från fread har ingen garanterad justering,
+// och kompilatorn gör om det till vanliga laddningar.
+void to_float(const void *in, float *out, size_t samples, sample_format f) {
+  const auto *p = static_cast<const uint8_t *>(in);
+
+  switch (f) {
+  case sample_format::s16:
+    for (size_t i = 0; i < samples; ++i) {
+      int16_t v;
+      std::memcpy(&v, p + 2 * i, 2);
+      out[i] = static_cast<float>(v) * (1.0f / 32768.0f);
+    }
+    break;
+  case sample_format::s24:
+    for (size_t i = 0; i < samples; ++i) {
+      int32_t v;
+      std::memcpy(&v, p + 4 * i, 4);
+      // teckenutvidga bit 23
+      v = static_cast<int32_t>(static_cast<uint32_t>(v) << 8) >> 8;
+      out[i] = static_cast<float>(v) * (1.0f / 8388608.0f);
+    }
+    break;
+  case sample_format::s24_3:
+    for (size_t i = 0; i < samples; ++i) {
+      const uint8_t *s = p + 3 * i;
+      const uint32_t u = static_cast<uint32_t>(s[0]) << 8 |
+                         static_cast<uint32_t>(s[1]) << 16 |
+                         static_cast<uint32_t>(s[2]) << 24;
+      out[i] = static_cast<float>(static_cast<int32_t>(u) >> 8) *
+               (1.0f / 8388608.0f);
+    }
+    break;
+  case sample_format::s32:
+    for (size_t i = 0; i < samples; ++i) {
+      int32_t v;
+      std::memcpy(&v, p + 4 * i, 4);
+      out[i] = static_cast<float>(v) * (1.0f / 2147483648.0f);
+    }
+    break;
+  case sample_format::f32:
+    std::memcpy(out, p, samples * sizeof(float));
+    break;
+  }
+}
+
+} // namespace audio
@@ -1,13 +1,60 @@
 #pragma once
 
+#include "control/now_playing.h"
+#include "control/preset_store.h"
+
 #include <atomic>
+#include <cstdint>
 #include <functional>
-#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
+
+namespace httplib {
+class Server;
+}
 
 namespace control {
 
+// En ingång till mixern, som den syns i GET /inputs
+struct input_status {
+  std::string name;
+  std::string source; // sökväg, "-" (stdin) eller "capture"
+  float gain_db = 0.0f;
+  int priority = 0;
+  float duck_db = 0.0f;
+  bool primary = false;
+  bool playing = false;
+  float level_db = -120.0f; // topp i senaste blocket
+  float ducked_db = 0.0f;   // aktuell sänkning från högre prioriteter
+  uint64_t underruns = 0;
+  bool connected = false; // skrivare/klient ansluten
+  uint64_t reconnects = 0;
+  float first_sample_ms = -1.0f; // anslutning till första sampel, -1 => inget
+};
+
+// POST/PATCH /inputs. Tomma fält lämnas som de är (PATCH) eller får
+// standardvärden (POST).
+struct input_request {
+  std::string name;
+  std::string path;     // fil, FIFO, tcp:PORT, unix:SÖKVÄG; "-" => stdin
+  bool capture = false; // line-in i stället för path
+  std::string format;   // librespot-namn, tomt => strömmens format
+  std::optional<float> gain_db;
+  std::optional<int> priority;
+  std::optional<float> duck_db;
+};
+
+// Mixerns ingångar. add/update kastar std::runtime_error vid fel.
+struct input_api {
+  std::function<std::vector<input_status>()> list;
+  std::function<void(const input_request &)> add;
+  std::function<bool(const input_request &)> update; // false => okänt namn
+  std::function<bool(const std::string &name)> remove;
+};
+
 // standard state för att kontrollera värden
 // varje värde pekar på central atomic
 struct control_state {
@@ -28,21 +75,105 @@ struct control_state {
   std::atomic<float> *eq_mid_db = nullptr;
   std::atomic<float> *eq_high_db = nullptr;
 
+  // limiter
+  std::atomic<float> *limiter_ceiling_db = nullptr;
+  std::atomic<float> *limiter_lookahead_ms = nullptr;
+  std::atomic<float> *limiter_release_ms = nullptr;
+  // endast läsning, skrivs av ljudtråden
+  std::atomic<float> *limiter_gain_reduction_db = nullptr;
+
+  // multiband-dynamik, arrayer med mbc_bands element
+  int mbc_bands = 0;
+  std::atomic<float> *mbc_threshold_db = nullptr;
+  std::atomic<float> *mbc_ratio = nullptr;
+  std::atomic<float> *mbc_expander_threshold_db = nullptr;
+  std::atomic<float> *mbc_expander_ratio = nullptr;
+  // endast läsning, skrivs av ljudtråden
+  std::atomic<float> *mbc_gain_reduction_db = nullptr;
+
+  // crossover, arrayer med crossover_ways element
+  int crossover_ways = 0;
+  std::atomic<float> *crossover_gain_db = nullptr;
+  std::atomic<float> *crossover_delay_ms = nullptr;
+  std::atomic<float> *crossover_invert = nullptr; // 0 eller 1
+
+  // loudness (EBU R128)
+  std::atomic<float> *loudness_normalize = nullptr; // 0 eller 1
+  std::atomic<float> *loudness_target_lufs = nullptr;
+  // endast läsning, skrivs av ljudtråden
+  std::atomic<float> *loudness_momentary_lufs = nullptr;
+  std::atomic<float> *loudness_short_term_lufs = nullptr;
+  std::atomic<float> *loudness_integrated_lufs = nullptr;
+  std::atomic<float> *loudness_gain_db = nullptr;
+
+  // dsp-kedjan vilar (tyst in, svansar avklingade), skrivs av ljudtråden
+  const std::atomic<bool> *dsp_idle = nullptr;
+
   // now playing
-  std::string *now_playing = nullptr;
-  std::mutex *now_playing_mutex = nullptr;
+  now_playing_store *now_playing = nullptr;
+
+  // rtp-ström (endast läsning, skrivs av sändare/mottagare)
+  const char *stream_mode = nullptr; // "send", "receive" eller nullptr
+  const std::atomic<uint64_t> *stream_packets = nullptr;
+  const std::atomic<uint64_t> *stream_packets_lost = nullptr;
+  const std::atomic<uint64_t> *stream_packets_late = nullptr;
+  const std::atomic<uint64_t> *stream_underruns = nullptr;
+  const std::atomic<uint64_t> *stream_overruns = nullptr;
+  const std::atomic<float> *stream_latency_ms = nullptr;
+  const std::atomic<float> *stream_jitter_ms = nullptr;
+  const std::atomic<float> *stream_drift_ppm = nullptr;
+  // mottagare: följer sändarens väggklocka, avvikelse från målet
+  const std::atomic<bool> *stream_clock_anchored = nullptr;
+  const std::atomic<float> *stream_sync_error_ms = nullptr;
+
+  // mixerns ingångar, /inputs
+  input_api inputs;
+
+  // förinställningar, /presets. Samlingen delas mellan zonerna.
+  preset_store *presets = nullptr;
+  // Byter kedja och alla värden i ett svep med kort övertoning. Kastar
+  // std::runtime_error vid okänd effekt i ordningen.
+  std::function<void(const preset &)> recall_preset;
+  // kedjans nuvarande ordning, effekternas namn
+  std::function<std::vector<std::string>()> effect_order;
+
+  // extra "nyckel: värde"-rader till /health, t.ex. realtidsinställningar
+  std::function<std::string()> health_details;
+};
+
+// En parameter som PATCH /state tar emot, med tillåtet intervall. target
+// är nullptr om zonen saknar den.
+struct state_param {
+  std::string name;
+  std::atomic<float> *target;
+  float min;
+  float max;
+};
+
+// Alla parametrar i state, i den ordning PATCH tillämpar dem
+std::vector<state_param> state_params(const control_state &state);
+
+// En zon i samma process: egna ingångar, DSP-kedja och utgång. Nås under
+// /zones/<id>/..., den första även direkt på roten.
+struct zone_state {
+  std::string id;
+  control_state state;
 };
 
 class control_server {
 public:
-  control_server(control_state state) : state(state) {}
+  // en zon, "main"
+  control_server(control_state state) : zones{{"main", std::move(state)}} {}
+  control_server(std::vector<zone_state> zones) : zones(std::move(zones)) {}
+  ~control_server();
 
   // t.ex. "0.0.0.0" och port 8080
   void start(const std::string &host, int port);
   void stop();
 
 private:
-  control_state state;
+  std::vector<zone_state> zones;
+  httplib::Server *server = nullptr;
   std::thread thread;
   std::atomic<bool> running{false};
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "control/now_playing.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace control {
+
+// Tar emot librespot-händelser via en named pipe. Hook-skriptet skriver en
+// rad per händelse med tab-separerade nyckel=värde-fält, t.ex.
+//
+//   event=track_changed\tname=...\tartist=...\tduration_ms=...
+//
+// Skrivningar <= PIPE_BUF är atomära så rader från samtidiga hooks blandas
+// inte. Kända nycklar: name, artist, duration_ms, position_ms, volume
+// (0-65535 som från librespot). Okända nycklar ignoreras.
+class event_fifo {
+public:
+  explicit event_fifo(now_playing_store &store) : store(store) {}
+  ~event_fifo() { stop(); }
+
+  event_fifo(const event_fifo &) = delete;
+  event_fifo &operator=(const event_fifo &) = delete;
+
+  // Skapar FIFO:n om den saknas. Kastar std::runtime_error om den inte kan
+  // skapas eller öppnas.
+  void start(const std::string &path);
+  void stop();
+
+  // Tolkar en rad och uppdaterar store. Exponerad för återanvändning.
+  static void apply_line(now_playing_store &store, const std::string &line);
+
+private:
+  now_playing_store &store;
+  std::thread thread;
+  std::atomic<bool> running{false};
+  int fd = -1;
+  int wake_fd[2] = {-1, -1};
+};
+
+} // namespace control
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace control {
+
+// Oföränderlig ögonblicksbild av vad som spelas. En ny instans publiceras
+// vid varje händelse, läsare tar bara en referens och låser aldrig.
+struct track_info {
+  std::string name;
+  std::string artist;
+  float duration_ms = 0.0f;
+  float position_ms = 0.0f;
+  float volume = 0.0f; // [0, 1]
+};
+
+class now_playing_store {
+public:
+  using snapshot = std::shared_ptr<const track_info>;
+
+  now_playing_store() : current_(std::make_shared<const track_info>()) {}
+
+  snapshot load() const noexcept {
+#ifdef __cpp_lib_atomic_shared_ptr
+    return current_.load(std::memory_order_acquire);
+#else
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+#endif
+  }
+
+  // Kopierar aktuell bild, låter fn ändra kopian och publicerar den.
+  // Flera skrivare (FIFO-läsaren och HTTP) hanteras med compare-exchange.
+  template <typename Fn> void update(Fn &&fn) {
+    snapshot prev = load();
+    while (true) {
+      auto next = std::make_shared<track_info>(*prev);
+      fn(*next);
+      const bool new_track =
+          next->name != prev->name || next->artist != prev->artist;
+      snapshot next_c = std::move(next);
+#ifdef __cpp_lib_atomic_shared_ptr
+      const bool done = current_.compare_exchange_weak(
+          prev, next_c, std::memory_order_acq_rel, std::memory_order_acquire);
+#else
+      const bool done = std::atomic_compare_exchange_weak_explicit(
+          &current_, &prev, next_c, std::memory_order_acq_rel,
+          std::memory_order_acquire);
+#endif
+      if (done) {
+        if (new_track)
+          track_changes_.fetch_add(1, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  // Räknas upp när låt eller artist ändras. Ljudtråden jämför med sitt
+  // senaste värde i stället för att läsa bilden (som kan låsa).
+  uint64_t track_changes() const noexcept {
+    return track_changes_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<uint64_t> track_changes_{0};
+#ifdef __cpp_lib_atomic_shared_ptr
+  std::atomic<snapshot> current_;
+#else
+  snapshot current_;
+#endif
+};
+
+} // namespace control
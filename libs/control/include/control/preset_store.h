@@ -0,0 +1,60 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace control {
+
+// Namngiven inställning: värden för parametrarna i PATCH /state och
+// ordningen på kedjans effekter (tom => standardordningen).
+struct preset {
+  std::string name;
+  std::vector<std::pair<std::string, float>> values;
+  std::vector<std::string> order;
+};
+
+// Förinställningar i en textfil, en rad per preset och en per zon för den
+// senast valda:
+//
+//   preset natt order=eq3band,multiband_dynamics,reverb gain_db=-6 ...
+//   last main natt
+//
+// Filen skrivs om i sin helhet (tmp + rename) vid varje ändring, så en
+// krasch mitt i lämnar den gamla kvar. Trådsäker; delas mellan zonerna.
+class preset_store {
+public:
+  // tom sökväg => bara i minnet
+  explicit preset_store(std::string path = "") : path(std::move(path)) {}
+
+  preset_store(const preset_store &) = delete;
+  preset_store &operator=(const preset_store &) = delete;
+
+  // Saknad fil är en tom samling. Kastar std::runtime_error vid formatfel.
+  void load();
+
+  std::vector<std::string> names() const;
+  bool find(const std::string &name, preset &out) const;
+  // Ersätter en preset med samma namn. Kastar std::runtime_error vid
+  // ogiltigt namn eller om filen inte går att skriva.
+  void put(const preset &p);
+  bool remove(const std::string &name);
+
+  // Senast valda preset för zonen, tom om ingen
+  std::string last(const std::string &zone) const;
+  void set_last(const std::string &zone, const std::string &name);
+
+  // Namn på presets och zoner: bokstäver, siffror, '_' och '-'
+  static bool valid_name(const std::string &name);
+
+private:
+  void save_locked() const;
+
+  std::string path;
+  mutable std::mutex mu;
+  std::vector<preset> presets;
+  std::vector<std::pair<std::string, std::string>> last_used; // zon, preset
+};
+
+} // namespace control
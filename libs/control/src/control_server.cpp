@@ -3,12 +3,20 @@
 // cpp-httplib
 #include "httplib.h"
 
+#include "trace/trace.h"
+
+#include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <chrono>
 #include <sstream>
+#include <thread>
 
 namespace {
 
+// Start för pågående anrop i denna servertråd, 0 => spåras inte
+thread_local uint64_t request_start_ns = 0;
+
 std::string json_escape(const std::string &in) {
   std::string out;
   out.reserve(in.size() + 8);
@@ -93,223 +101,691 @@ bool parse_json_name(const std::string &body, std::string &out) {
   return false;
 }
 
+// name, path, capture, format, gain_db, priority, duck_db. std::stof/stoi
+// kastar vid ogiltiga tal.
+control::input_request parse_input_request(const httplib::Request &req) {
+  control::input_request r;
+  r.name = req.get_param_value("name");
+  r.path = req.get_param_value("path");
+  r.capture = req.get_param_value("capture") == "1";
+  r.format = req.get_param_value("format");
+  if (req.has_param("gain_db"))
+    r.gain_db = std::clamp(std::stof(req.get_param_value("gain_db")), -60.0f,
+                           12.0f);
+  if (req.has_param("priority"))
+    r.priority = std::stoi(req.get_param_value("priority"));
+  if (req.has_param("duck_db"))
+    r.duck_db = std::clamp(std::stof(req.get_param_value("duck_db")), -60.0f,
+                           0.0f);
+  return r;
+}
+
 } // namespace
 
 namespace control {
 
-void control_server::start(const std::string &host, int port) {
-  if (running.exchange(true))
-    return;
+std::vector<state_param> state_params(const control_state &state) {
+  std::vector<state_param> out = {
+      {"gain_db", state.gain_db, -60.0f, 12.0f},
+      {"reverb_delay_ms", state.reverb_delay_ms, 0.0f, 2000.0f},
+      {"reverb_feedback", state.reverb_feedback, 0.0f, 1.0f},
+      {"reverb_wet", state.reverb_wet, 0.0f, 1.0f},
+      {"reverb_dry", state.reverb_dry, 0.0f, 1.0f},
+      {"dc_blocker_cutoff_hz", state.dc_blocker_cutoff_hz, 1.0f, 2000.0f},
+      {"eq_low_db", state.eq_low_db, -12.0f, 12.0f},
+      {"eq_mid_db", state.eq_mid_db, -12.0f, 12.0f},
+      {"eq_high_db", state.eq_high_db, -12.0f, 12.0f},
+      {"limiter_ceiling_db", state.limiter_ceiling_db, -24.0f, 0.0f},
+      {"limiter_lookahead_ms", state.limiter_lookahead_ms, 1.0f, 5.0f},
+      {"limiter_release_ms", state.limiter_release_ms, 1.0f, 1000.0f},
+      {"loudness_normalize", state.loudness_normalize, 0.0f, 1.0f},
+      {"loudness_target_lufs", state.loudness_target_lufs, -36.0f, -6.0f},
+  };
+  // mbc_threshold_db_0, mbc_ratio_2, mbc_expander_ratio_1, ...
+  for (int b = 0; b < state.mbc_bands; b++) {
+    const std::string n = std::to_string(b);
+    out.push_back(
+        {"mbc_threshold_db_" + n, &state.mbc_threshold_db[b], -60.0f, 0.0f});
+    out.push_back({"mbc_ratio_" + n, &state.mbc_ratio[b], 1.0f, 20.0f});
+    if (state.mbc_expander_threshold_db) {
+      out.push_back({"mbc_expander_threshold_db_" + n,
+                     &state.mbc_expander_threshold_db[b], -90.0f, 0.0f});
+      out.push_back({"mbc_expander_ratio_" + n, &state.mbc_expander_ratio[b],
+                     1.0f, 10.0f});
+    }
+  }
+  // crossover_gain_db_0, crossover_delay_ms_1, ...
+  for (int w = 0; w < state.crossover_ways; w++) {
+    const std::string n = std::to_string(w);
+    out.push_back(
+        {"crossover_gain_db_" + n, &state.crossover_gain_db[w], -24.0f, 0.0f});
+    out.push_back(
+        {"crossover_delay_ms_" + n, &state.crossover_delay_ms[w], 0.0f, 10.0f});
+    out.push_back(
+        {"crossover_invert_" + n, &state.crossover_invert[w], 0.0f, 1.0f});
+  }
+  return out;
+}
 
-  thread = std::thread([this, host, port]() {
-    httplib::Server svr;
+namespace {
 
-    // CORS (dev): allow controller UI on localhost:5173
-    svr.set_default_headers({
-        {"Access-Control-Allow-Origin", "http://localhost:5173"},
-        {"Access-Control-Allow-Methods", "GET, POST, OPTIONS, PATCH"},
-        {"Access-Control-Allow-Headers", "Content-Type"},
-    });
+// Vägarna för en zon under prefix ("" eller "/zones/<id>"). state ligger i
+// control_server::zones och flyttas inte efter start().
+void add_zone_routes(httplib::Server &svr, const std::string &prefix,
+                     const std::string &zone_id, control_state &state) {
+  // GET /health
+  svr.Get(prefix + "/health", [&state](const httplib::Request &,
+                                       httplib::Response &res) {
+    std::string body = "ok\n";
+    if (state.health_details) {
+      body += state.health_details();
+    }
+    res.set_content(body, "text/plain");
+  });
 
-    // Preflight
-    svr.Options(R"(.*)", [](const httplib::Request &, httplib::Response &res) {
-      res.status = 204;
-    });
+  // GET /state
+  svr.Get(prefix + "/state", [&state](const httplib::Request &,
+                                      httplib::Response &res) {
+    float gain_db = 0.0f;
+    if (state.gain_db) {
+      gain_db = state.gain_db->load(std::memory_order_relaxed);
+    }
 
-    // GET /health
-    svr.Get("/health", [](const httplib::Request &, httplib::Response &res) {
-      res.set_content("ok\n", "text/plain");
-    });
+    float reverb_delay_ms = 0.0f, reverb_feedback = 0.0f, reverb_wet = 0.0f,
+          reverb_dry = 0.0f;
+    if (state.reverb_delay_ms) {
+      reverb_delay_ms =
+          state.reverb_delay_ms->load(std::memory_order_relaxed);
+    }
+    if (state.reverb_feedback) {
+      reverb_feedback =
+          state.reverb_feedback->load(std::memory_order_relaxed);
+    }
+    if (state.reverb_wet) {
+      reverb_wet = state.reverb_wet->load(std::memory_order_relaxed);
+    }
+    if (state.reverb_dry) {
+      reverb_dry = state.reverb_dry->load(std::memory_order_relaxed);
+    }
 
-    // GET /state
-    svr.Get("/state", [this](const httplib::Request &, httplib::Response &res) {
-      float gain_db = 0.0f;
-      if (state.gain_db) {
-        gain_db = state.gain_db->load(std::memory_order_relaxed);
-      }
+    float dc_blocker_cutoff_hz = 0.0f;
+    if (state.dc_blocker_cutoff_hz) {
+      dc_blocker_cutoff_hz =
+          state.dc_blocker_cutoff_hz->load(std::memory_order_relaxed);
+    }
 
-      float reverb_delay_ms = 0.0f, reverb_feedback = 0.0f, reverb_wet = 0.0f,
-            reverb_dry = 0.0f;
-      if (state.reverb_delay_ms) {
-        reverb_delay_ms =
-            state.reverb_delay_ms->load(std::memory_order_relaxed);
-      }
-      if (state.reverb_feedback) {
-        reverb_feedback =
-            state.reverb_feedback->load(std::memory_order_relaxed);
-      }
-      if (state.reverb_wet) {
-        reverb_wet = state.reverb_wet->load(std::memory_order_relaxed);
-      }
-      if (state.reverb_dry) {
-        reverb_dry = state.reverb_dry->load(std::memory_order_relaxed);
-      }
+    float eq_low_db = 0.0f, eq_mid_db = 0.0f, eq_high_db = 0.0f;
+    if (state.eq_low_db) {
+      eq_low_db = state.eq_low_db->load(std::memory_order_relaxed);
+    }
+    if (state.eq_mid_db) {
+      eq_mid_db = state.eq_mid_db->load(std::memory_order_relaxed);
+    }
+    if (state.eq_high_db) {
+      eq_high_db = state.eq_high_db->load(std::memory_order_relaxed);
+    }
+
+    float limiter_ceiling_db = 0.0f, limiter_lookahead_ms = 0.0f,
+          limiter_release_ms = 0.0f, limiter_gain_reduction_db = 0.0f;
+    if (state.limiter_ceiling_db) {
+      limiter_ceiling_db =
+          state.limiter_ceiling_db->load(std::memory_order_relaxed);
+    }
+    if (state.limiter_lookahead_ms) {
+      limiter_lookahead_ms =
+          state.limiter_lookahead_ms->load(std::memory_order_relaxed);
+    }
+    if (state.limiter_release_ms) {
+      limiter_release_ms =
+          state.limiter_release_ms->load(std::memory_order_relaxed);
+    }
+    if (state.limiter_gain_reduction_db) {
+      limiter_gain_reduction_db =
+          state.limiter_gain_reduction_db->load(std::memory_order_relaxed);
+    }
 
-      float dc_blocker_cutoff_hz = 0.0f;
-      if (state.dc_blocker_cutoff_hz) {
-        dc_blocker_cutoff_hz =
-            state.dc_blocker_cutoff_hz->load(std::memory_order_relaxed);
+    auto f32 = [](const std::atomic<float> *v, float def) -> float {
+      return v ? v->load(std::memory_order_relaxed) : def;
+    };
+
+    std::ostringstream mbc;
+    for (int b = 0; b < state.mbc_bands; b++) {
+      mbc << "\"mbc_threshold_db_" << b << "\":"
+          << state.mbc_threshold_db[b].load(std::memory_order_relaxed)
+          << ",";
+      mbc << "\"mbc_ratio_" << b << "\":"
+          << state.mbc_ratio[b].load(std::memory_order_relaxed) << ",";
+      if (state.mbc_expander_threshold_db) {
+        mbc << "\"mbc_expander_threshold_db_" << b << "\":"
+            << state.mbc_expander_threshold_db[b].load(
+                   std::memory_order_relaxed)
+            << ",";
+        mbc << "\"mbc_expander_ratio_" << b << "\":"
+            << state.mbc_expander_ratio[b].load(std::memory_order_relaxed)
+            << ",";
       }
+      mbc << "\"mbc_gain_reduction_db_" << b << "\":"
+          << state.mbc_gain_reduction_db[b].load(std::memory_order_relaxed)
+          << ",";
+    }
+
+    std::ostringstream xo;
+    for (int w = 0; w < state.crossover_ways; w++) {
+      xo << "\"crossover_gain_db_" << w << "\":"
+         << state.crossover_gain_db[w].load(std::memory_order_relaxed)
+         << ",";
+      xo << "\"crossover_delay_ms_" << w << "\":"
+         << state.crossover_delay_ms[w].load(std::memory_order_relaxed)
+         << ",";
+      xo << "\"crossover_invert_" << w << "\":"
+         << state.crossover_invert[w].load(std::memory_order_relaxed)
+         << ",";
+    }
+
+    now_playing_store::snapshot now_playing;
+    if (state.now_playing) {
+      now_playing = state.now_playing->load();
+    }
+
+    std::ostringstream os;
+    os << "{";
+
+    os << "\"gain_db\":" << gain_db << ",";
+
+    os << "\"reverb_delay_ms\":" << reverb_delay_ms << ",";
+    os << "\"reverb_feedback\":" << reverb_feedback << ",";
+    os << "\"reverb_wet\":" << reverb_wet << ",";
+    os << "\"reverb_dry\":" << reverb_dry << ",";
+    os << "\"dc_blocker_cutoff_hz\":" << dc_blocker_cutoff_hz << ",";
+
+    os << "\"eq_low_db\":" << eq_low_db << ",";
+    os << "\"eq_mid_db\":" << eq_mid_db << ",";
+    os << "\"eq_high_db\":" << eq_high_db << ",";
+
+    os << "\"limiter_ceiling_db\":" << limiter_ceiling_db << ",";
+    os << "\"limiter_lookahead_ms\":" << limiter_lookahead_ms << ",";
+    os << "\"limiter_release_ms\":" << limiter_release_ms << ",";
+    os << "\"limiter_gain_reduction_db\":" << limiter_gain_reduction_db
+       << ",";
+
+    os << "\"loudness_normalize\":" << f32(state.loudness_normalize, 0.0f)
+       << ",";
+    os << "\"loudness_target_lufs\":" << f32(state.loudness_target_lufs, 0.0f)
+       << ",";
+    os << "\"loudness_momentary_lufs\":"
+       << f32(state.loudness_momentary_lufs, -120.0f) << ",";
+    os << "\"loudness_short_term_lufs\":"
+       << f32(state.loudness_short_term_lufs, -120.0f) << ",";
+    os << "\"loudness_integrated_lufs\":"
+       << f32(state.loudness_integrated_lufs, -120.0f) << ",";
+    os << "\"loudness_gain_db\":" << f32(state.loudness_gain_db, 0.0f) << ",";
+
+    os << "\"mbc_bands\":" << state.mbc_bands << ",";
+    os << mbc.str();
+
+    os << "\"crossover_ways\":" << state.crossover_ways << ",";
+    os << xo.str();
+
+    const bool dsp_idle =
+        state.dsp_idle && state.dsp_idle->load(std::memory_order_relaxed);
+    os << "\"dsp_idle\":" << (dsp_idle ? "true" : "false") << ",";
+
+    if (now_playing) {
+      os << "\"now_playing\":\"" << json_escape(now_playing->name) << "\",";
+      os << "\"now_playing_artist\":\"" << json_escape(now_playing->artist)
+         << "\",";
+      os << "\"now_playing_duration_ms\":" << now_playing->duration_ms
+         << ",";
+      os << "\"now_playing_position_ms\":" << now_playing->position_ms
+         << ",";
+      os << "\"now_playing_volume\":" << now_playing->volume;
+    } else {
+      os << "\"now_playing\":\"\"";
+    }
+
+    os << "}";
+
+    res.set_content(os.str(), "application/json");
+  });
+
+  // GET /stream
+  svr.Get(prefix + "/stream", [&state](const httplib::Request &,
+                                       httplib::Response &res) {
+    if (!state.stream_mode) {
+      res.status = 404;
+      res.set_content("stream not configured\n", "text/plain");
+      return;
+    }
 
-      float eq_low_db = 0.0f, eq_mid_db = 0.0f, eq_high_db = 0.0f;
-      if (state.eq_low_db) {
-        eq_low_db = state.eq_low_db->load(std::memory_order_relaxed);
+    auto u64 = [](const std::atomic<uint64_t> *v) -> uint64_t {
+      return v ? v->load(std::memory_order_relaxed) : 0;
+    };
+    auto f32 = [](const std::atomic<float> *v) -> float {
+      return v ? v->load(std::memory_order_relaxed) : 0.0f;
+    };
+
+    std::ostringstream os;
+    os << "{";
+    os << "\"mode\":\"" << state.stream_mode << "\",";
+    os << "\"packets\":" << u64(state.stream_packets) << ",";
+    os << "\"packets_lost\":" << u64(state.stream_packets_lost) << ",";
+    os << "\"packets_late\":" << u64(state.stream_packets_late) << ",";
+    os << "\"underruns\":" << u64(state.stream_underruns) << ",";
+    os << "\"overruns\":" << u64(state.stream_overruns) << ",";
+    os << "\"latency_ms\":" << f32(state.stream_latency_ms) << ",";
+    os << "\"jitter_ms\":" << f32(state.stream_jitter_ms) << ",";
+    os << "\"drift_ppm\":" << f32(state.stream_drift_ppm);
+    if (state.stream_clock_anchored) {
+      os << ",\"clock_anchored\":"
+         << (state.stream_clock_anchored->load(std::memory_order_relaxed)
+                 ? "true"
+                 : "false");
+      os << ",\"sync_error_ms\":" << f32(state.stream_sync_error_ms);
+    }
+    os << "}";
+
+    res.set_content(os.str(), "application/json");
+  });
+
+  // POST /gain?db=-6.0
+  svr.Post(prefix + "/gain",
+           [&state](const httplib::Request &req, httplib::Response &res) {
+             if (!state.gain_db) {
+               res.status = 500;
+               res.set_content("gain not configured\n", "text/plain");
+               return;
+             }
+             if (!req.has_param("db")) {
+               res.status = 400;
+               res.set_content("missing db param\n", "text/plain");
+               return;
+             }
+             const auto dbStr = req.get_param_value("db");
+             try {
+               float db = std::stof(dbStr);
+               // clampa rimligt
+               if (db < -60.0f)
+                 db = -60.0f;
+               if (db > 12.0f)
+                 db = 12.0f;
+
+               state.gain_db->store(db, std::memory_order_relaxed);
+               res.set_content("ok\n", "text/plain");
+             } catch (...) {
+               res.status = 400;
+               res.set_content("invalid db\n", "text/plain");
+             }
+           });
+
+  // PATCH /state?gain_db=-6&reverb_wet=0.2
+  svr.Patch(prefix + "/state", [&state](const httplib::Request &req,
+                                        httplib::Response &res) {
+    int updated = 0;
+    auto apply = [&](const char *name, std::atomic<float> *target,
+                     float min_v, float max_v, bool clamp) -> bool {
+      if (!req.has_param(name))
+        return true;
+      if (!target) {
+        res.status = 500;
+        res.set_content("param not configured\n", "text/plain");
+        return false;
       }
-      if (state.eq_mid_db) {
-        eq_mid_db = state.eq_mid_db->load(std::memory_order_relaxed);
+      try {
+        float v = std::stof(req.get_param_value(name));
+        if (clamp) {
+          if (v < min_v)
+            v = min_v;
+          if (v > max_v)
+            v = max_v;
+        }
+        target->store(v, std::memory_order_relaxed);
+        updated++;
+        return true;
+      } catch (...) {
+        res.status = 400;
+        res.set_content("invalid param\n", "text/plain");
+        return false;
       }
-      if (state.eq_high_db) {
-        eq_high_db = state.eq_high_db->load(std::memory_order_relaxed);
+    };
+
+    for (const state_param &p : state_params(state)) {
+      if (!apply(p.name.c_str(), p.target, p.min, p.max, true))
+        return;
+    }
+
+    if (updated == 0) {
+      res.status = 400;
+      res.set_content("no params\n", "text/plain");
+      return;
+    }
+
+    res.set_content("ok\n", "text/plain");
+  });
+
+  // GET /inputs
+  svr.Get(prefix + "/inputs", [&state](const httplib::Request &,
+                                       httplib::Response &res) {
+    if (!state.inputs.list) {
+      res.status = 404;
+      res.set_content("inputs not configured\n", "text/plain");
+      return;
+    }
+
+    std::ostringstream os;
+    os << "[";
+    bool first = true;
+    for (const input_status &in : state.inputs.list()) {
+      if (!first)
+        os << ",";
+      first = false;
+      os << "{";
+      os << "\"name\":\"" << json_escape(in.name) << "\",";
+      os << "\"source\":\"" << json_escape(in.source) << "\",";
+      os << "\"gain_db\":" << in.gain_db << ",";
+      os << "\"priority\":" << in.priority << ",";
+      os << "\"duck_db\":" << in.duck_db << ",";
+      os << "\"primary\":" << (in.primary ? "true" : "false") << ",";
+      os << "\"playing\":" << (in.playing ? "true" : "false") << ",";
+      os << "\"level_db\":" << in.level_db << ",";
+      os << "\"ducked_db\":" << in.ducked_db << ",";
+      os << "\"underruns\":" << in.underruns << ",";
+      os << "\"connected\":" << (in.connected ? "true" : "false") << ",";
+      os << "\"reconnects\":" << in.reconnects << ",";
+      os << "\"first_sample_ms\":" << in.first_sample_ms;
+      os << "}";
+    }
+    os << "]";
+
+    res.set_content(os.str(), "application/json");
+  });
+
+  // POST /inputs?name=doorbell&path=/srv/doorbell.raw&priority=10
+  // POST /inputs?name=line&capture=1&priority=5&duck_db=-12
+  svr.Post(prefix + "/inputs", [&state](const httplib::Request &req,
+                                        httplib::Response &res) {
+    if (!state.inputs.add) {
+      res.status = 404;
+      res.set_content("inputs not configured\n", "text/plain");
+      return;
+    }
+    try {
+      const input_request r = parse_input_request(req);
+      if (r.name.empty() || (r.path.empty() && !r.capture)) {
+        res.status = 400;
+        res.set_content("missing name or path\n", "text/plain");
+        return;
       }
+      state.inputs.add(r);
+      res.set_content("ok\n", "text/plain");
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(std::string(e.what()) + "\n", "text/plain");
+    }
+  });
 
-      std::string now_playing;
-      if (state.now_playing && state.now_playing_mutex) {
-        std::lock_guard<std::mutex> lock(*state.now_playing_mutex);
-        now_playing = *state.now_playing;
+  // PATCH /inputs?name=doorbell&gain_db=-3
+  svr.Patch(prefix + "/inputs", [&state](const httplib::Request &req,
+                                         httplib::Response &res) {
+    if (!state.inputs.update) {
+      res.status = 404;
+      res.set_content("inputs not configured\n", "text/plain");
+      return;
+    }
+    try {
+      if (!state.inputs.update(parse_input_request(req))) {
+        res.status = 404;
+        res.set_content("unknown input\n", "text/plain");
+        return;
       }
+      res.set_content("ok\n", "text/plain");
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(std::string(e.what()) + "\n", "text/plain");
+    }
+  });
 
-      std::ostringstream os;
-      os << "{";
+  // DELETE /inputs?name=doorbell
+  svr.Delete(prefix + "/inputs", [&state](const httplib::Request &req,
+                                          httplib::Response &res) {
+    if (!state.inputs.remove) {
+      res.status = 404;
+      res.set_content("inputs not configured\n", "text/plain");
+      return;
+    }
+    if (!state.inputs.remove(req.get_param_value("name"))) {
+      res.status = 404;
+      res.set_content("unknown input\n", "text/plain");
+      return;
+    }
+    res.set_content("ok\n", "text/plain");
+  });
 
-      os << "\"gain_db\":" << gain_db << ",";
+  // GET /presets
+  svr.Get(prefix + "/presets", [&state, zone_id](const httplib::Request &,
+                                                 httplib::Response &res) {
+    if (!state.presets) {
+      res.status = 404;
+      res.set_content("presets not configured\n", "text/plain");
+      return;
+    }
+    std::ostringstream os;
+    os << "{\"active\":\"" << json_escape(state.presets->last(zone_id))
+       << "\",\"order\":[";
+    if (state.effect_order) {
+      const std::vector<std::string> order = state.effect_order();
+      for (size_t i = 0; i < order.size(); i++)
+        os << (i ? "," : "") << "\"" << json_escape(order[i]) << "\"";
+    }
+    os << "],\"presets\":[";
+    const std::vector<std::string> names = state.presets->names();
+    for (size_t i = 0; i < names.size(); i++)
+      os << (i ? "," : "") << "\"" << json_escape(names[i]) << "\"";
+    os << "]}";
+    res.set_content(os.str(), "application/json");
+  });
 
-      os << "\"reverb_delay_ms\":" << reverb_delay_ms << ",";
-      os << "\"reverb_feedback\":" << reverb_feedback << ",";
-      os << "\"reverb_wet\":" << reverb_wet << ",";
-      os << "\"reverb_dry\":" << reverb_dry << ",";
-      os << "\"dc_blocker_cutoff_hz\":" << dc_blocker_cutoff_hz << ",";
+  // POST /presets?name=natt[&order=eq3band,reverb,...]
+  // Sparar zonens nuvarande värden och ordning under namnet.
+  svr.Post(prefix + "/presets", [&state](const httplib::Request &req,
+                                         httplib::Response &res) {
+    if (!state.presets) {
+      res.status = 404;
+      res.set_content("presets not configured\n", "text/plain");
+      return;
+    }
+    preset p;
+    p.name = req.get_param_value("name");
+    for (const state_param &sp : state_params(state)) {
+      if (sp.target)
+        p.values.emplace_back(sp.name,
+                              sp.target->load(std::memory_order_relaxed));
+    }
+    if (req.has_param("order")) {
+      std::istringstream in(req.get_param_value("order"));
+      std::string e;
+      while (std::getline(in, e, ','))
+        p.order.push_back(e);
+    } else if (state.effect_order) {
+      p.order = state.effect_order();
+    }
+    try {
+      state.presets->put(p);
+      res.set_content("ok\n", "text/plain");
+    } catch (const std::exception &e) {
+      res.status = 400;
+      res.set_content(std::string(e.what()) + "\n", "text/plain");
+    }
+  });
 
-      os << "\"eq_low_db\":" << eq_low_db << ",";
-      os << "\"eq_mid_db\":" << eq_mid_db << ",";
-      os << "\"eq_high_db\":" << eq_high_db << ",";
+  // POST /presets/recall?name=natt
+  svr.Post(prefix + "/presets/recall",
+           [&state, zone_id](const httplib::Request &req,
+                             httplib::Response &res) {
+             if (!state.presets || !state.recall_preset) {
+               res.status = 404;
+               res.set_content("presets not configured\n", "text/plain");
+               return;
+             }
+             preset p;
+             if (!state.presets->find(req.get_param_value("name"), p)) {
+               res.status = 404;
+               res.set_content("unknown preset\n", "text/plain");
+               return;
+             }
+             try {
+               state.recall_preset(p);
+               state.presets->set_last(zone_id, p.name);
+               res.set_content("ok\n", "text/plain");
+             } catch (const std::exception &e) {
+               res.status = 400;
+               res.set_content(std::string(e.what()) + "\n", "text/plain");
+             }
+           });
+
+  // DELETE /presets?name=natt
+  svr.Delete(prefix + "/presets", [&state](const httplib::Request &req,
+                                           httplib::Response &res) {
+    if (!state.presets) {
+      res.status = 404;
+      res.set_content("presets not configured\n", "text/plain");
+      return;
+    }
+    try {
+      if (!state.presets->remove(req.get_param_value("name"))) {
+        res.status = 404;
+        res.set_content("unknown preset\n", "text/plain");
+        return;
+      }
+      res.set_content("ok\n", "text/plain");
+    } catch (const std::exception &e) {
+      res.status = 500;
+      res.set_content(std::string(e.what()) + "\n", "text/plain");
+    }
+  });
 
-      os << "\"now_playing\":\"" << json_escape(now_playing) << "\"";
+  // POST /now_playing?name=...
+  // Äldre väg; hook-skriptet skriver i första hand till event-FIFO:n.
+  svr.Post(prefix + "/now_playing",
+           [&state](const httplib::Request &req, httplib::Response &res) {
+             if (!state.now_playing) {
+               res.status = 500;
+               res.set_content("now_playing not configured\n", "text/plain");
+               return;
+             }
+
+             std::string name;
+             bool got = false;
+             if (req.has_param("name")) {
+               name = req.get_param_value("name");
+               got = true;
+             } else if (!req.body.empty()) {
+               got = parse_json_name(req.body, name);
+             }
+
+             if (!got) {
+               res.status = 400;
+               res.set_content("missing name\n", "text/plain");
+               return;
+             }
+
+             state.now_playing->update(
+                 [&](track_info &t) { t.name = std::move(name); });
+             res.set_content("ok\n", "text/plain");
+           });
+}
 
-      os << "}";
+} // namespace
 
-      res.set_content(os.str(), "application/json");
+void control_server::start(const std::string &host, int port) {
+  if (running.exchange(true))
+    return;
+
+  server = new httplib::Server();
+  thread = std::thread([this, host, port]() {
+    httplib::Server &svr = *server;
+
+    // CORS (dev): allow controller UI on localhost:5173
+    svr.set_default_headers({
+        {"Access-Control-Allow-Origin", "http://localhost:5173"},
+        {"Access-Control-Allow-Methods", "GET, POST, OPTIONS, PATCH, DELETE"},
+        {"Access-Control-Allow-Headers", "Content-Type"},
     });
 
-    // POST /gain?db=-6.0
-    svr.Post("/gain",
-             [this](const httplib::Request &req, httplib::Response &res) {
-               if (!state.gain_db) {
-                 res.status = 500;
-                 res.set_content("gain not configured\n", "text/plain");
-                 return;
-               }
-               if (!req.has_param("db")) {
-                 res.status = 400;
-                 res.set_content("missing db param\n", "text/plain");
-                 return;
-               }
-               const auto dbStr = req.get_param_value("db");
-               try {
-                 float db = std::stof(dbStr);
-                 // clampa rimligt
-                 if (db < -60.0f)
-                   db = -60.0f;
-                 if (db > 12.0f)
-                   db = 12.0f;
-
-                 state.gain_db->store(db, std::memory_order_relaxed);
-                 res.set_content("ok\n", "text/plain");
-               } catch (...) {
-                 res.status = 400;
-                 res.set_content("invalid db\n", "text/plain");
-               }
-             });
-
-    // PATCH /state?gain_db=-6&reverb_wet=0.2
-    svr.Patch("/state", [this](const httplib::Request &req,
-                               httplib::Response &res) {
-      int updated = 0;
-      auto apply = [&](const char *name, std::atomic<float> *target,
-                       float min_v, float max_v, bool clamp) -> bool {
-        if (!req.has_param(name))
-          return true;
-        if (!target) {
-          res.status = 500;
-          res.set_content("param not configured\n", "text/plain");
-          return false;
-        }
-        try {
-          float v = std::stof(req.get_param_value(name));
-          if (clamp) {
-            if (v < min_v)
-              v = min_v;
-            if (v > max_v)
-              v = max_v;
+    // Varje anrop blir en händelse i /trace, t.ex. "PATCH /state". Namnet
+    // tas från vägens mönster, så att antalet internerade namn är fast;
+    // anrop som inte matchade någon väg spåras inte.
+    svr.set_pre_routing_handler(
+        [](const httplib::Request &, httplib::Response &) {
+          request_start_ns = 0;
+          if (trace::enabled()) {
+            trace::register_thread("http");
+            request_start_ns = trace::now_ns();
           }
-          target->store(v, std::memory_order_relaxed);
-          updated++;
-          return true;
-        } catch (...) {
-          res.status = 400;
-          res.set_content("invalid param\n", "text/plain");
-          return false;
-        }
-      };
+          return httplib::Server::HandlerResponse::Unhandled;
+        });
+    svr.set_post_routing_handler(
+        [](const httplib::Request &req, httplib::Response &) {
+          if (request_start_ns == 0 || req.matched_route.empty())
+            return;
+          const std::string name = req.method + " " + req.matched_route;
+          trace::complete(trace::intern(name), request_start_ns,
+                          trace::now_ns());
+          request_start_ns = 0;
+        });
 
-      if (!apply("gain_db", state.gain_db, -60.0f, 12.0f, true))
-        return;
-      if (!apply("reverb_delay_ms", state.reverb_delay_ms, 0.0f, 2000.0f, true))
-        return;
-      if (!apply("reverb_feedback", state.reverb_feedback, 0.0f, 1.0f, true))
-        return;
-      if (!apply("reverb_wet", state.reverb_wet, 0.0f, 1.0f, true))
-        return;
-      if (!apply("reverb_dry", state.reverb_dry, 0.0f, 1.0f, true))
-        return;
-      if (!apply("dc_blocker_cutoff_hz", state.dc_blocker_cutoff_hz, 1.0f,
-                 2000.0f, true))
-        return;
-      if (!apply("eq_low_db", state.eq_low_db, -12.0f, 12.0f, true))
-        return;
-      if (!apply("eq_mid_db", state.eq_mid_db, -12.0f, 12.0f, true))
-        return;
-      if (!apply("eq_high_db", state.eq_high_db, -12.0f, 12.0f, true))
+    // Preflight
+    svr.Options(R"(.*)", [](const httplib::Request &, httplib::Response &res) {
+      res.status = 204;
+    });
+
+    // GET /trace?seconds=N
+    // Spelar in N sekunder (standard 5, högst 30) och svarar med Chrome
+    // trace-event JSON för chrome://tracing eller ui.perfetto.dev.
+    svr.Get("/trace", [](const httplib::Request &req, httplib::Response &res) {
+      if (!trace::compiled_in) {
+        res.status = 404;
+        res.set_content("trace not compiled in\n", "text/plain");
         return;
+      }
 
-      if (updated == 0) {
+      float seconds = 5.0f;
+      try {
+        if (req.has_param("seconds"))
+          seconds = std::stof(req.get_param_value("seconds"));
+      } catch (...) {
         res.status = 400;
-        res.set_content("no params\n", "text/plain");
+        res.set_content("invalid seconds\n", "text/plain");
         return;
       }
+      seconds = std::clamp(seconds, 0.1f, 30.0f);
 
-      res.set_content("ok\n", "text/plain");
+      const uint64_t from = trace::now_ns();
+      trace::start();
+      std::this_thread::sleep_for(std::chrono::duration<float>(seconds));
+      trace::stop();
+      const uint64_t to = trace::now_ns();
+
+      res.set_content(trace::chrome_json(from, to), "application/json");
     });
 
-    // POST /now_playing?name=...
-    svr.Post("/now_playing",
-             [this](const httplib::Request &req, httplib::Response &res) {
-               if (!state.now_playing || !state.now_playing_mutex) {
-                 res.status = 500;
-                 res.set_content("now_playing not configured\n", "text/plain");
-                 return;
-               }
-
-               std::string name;
-               bool got = false;
-               if (req.has_param("name")) {
-                 name = req.get_param_value("name");
-                 got = true;
-               } else if (!req.body.empty()) {
-                 got = parse_json_name(req.body, name);
-               }
-
-               if (!got) {
-                 res.status = 400;
-                 res.set_content("missing name\n", "text/plain");
-                 return;
-               }
-
-               {
-                 std::lock_guard<std::mutex> lock(*state.now_playing_mutex);
-                 *state.now_playing = name;
-               }
-               res.set_content("ok\n", "text/plain");
-             });
+    // GET /zones
+    svr.Get("/zones", [this](const httplib::Request &, httplib::Response &res) {
+      std::ostringstream os;
+      os << "{\"zones\":[";
+      for (size_t i = 0; i < zones.size(); i++) {
+        os << (i ? "," : "") << "\"" << json_escape(zones[i].id) << "\"";
+      }
+      os << "]}";
+      res.set_content(os.str(), "application/json");
+    });
+
+    // Första zonen även direkt på roten (/state, /inputs, ...) som förut
+    for (size_t i = 0; i < zones.size(); i++) {
+      if (i == 0)
+        add_zone_routes(svr, "", zones[i].id, zones[i].state);
+      add_zone_routes(svr, "/zones/" + zones[i].id, zones[i].id,
+                      zones[i].state);
+    }
 
     // Blockande lyssning (kör i separat tråd)
     svr.listen(host, port);
@@ -318,11 +794,20 @@ void control_server::start(const std::string &host, int port) {
 }
 
 void control_server::stop() {
-  // Minimal variant: du kan utöka med server.stop() om du håller serverobjektet
-  // som member.
+  if (server) {
+    // stop() före listen() ignoreras av httplib; vänta tills servern är
+    // igång eller listen() har gett upp (då nollställer tråden running)
+    while (running.load() && !server->is_running())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    server->stop();
+  }
   running.store(false);
   if (thread.joinable())
     thread.join();
+  delete server;
+  server = nullptr;
 }
 
+control_server::~control_server() { stop(); }
+
 } // namespace control
@@ -0,0 +1,137 @@
+#include "control/event_fifo.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+float parse_float(std::string_view v) {
+  const std::string s(v);
+  return std::strtof(s.c_str(), nullptr);
+}
+
+} // namespace
+
+namespace control {
+
+void event_fifo::apply_line(now_playing_store &store, const std::string &line) {
+  if (line.empty())
+    return;
+
+  store.update([&](track_info &t) {
+    std::string_view rest(line);
+    while (!rest.empty()) {
+      const size_t tab = rest.find('\t');
+      const std::string_view field = rest.substr(0, tab);
+      rest = tab == std::string_view::npos ? std::string_view{}
+                                           : rest.substr(tab + 1);
+
+      const size_t eq = field.find('=');
+      if (eq == std::string_view::npos)
+        continue;
+      const std::string_view key = field.substr(0, eq);
+      const std::string_view value = field.substr(eq + 1);
+
+      if (key == "name") {
+        t.name = value;
+      } else if (key == "artist") {
+        t.artist = value;
+      } else if (key == "duration_ms") {
+        t.duration_ms = parse_float(value);
+      } else if (key == "position_ms") {
+        t.position_ms = parse_float(value);
+      } else if (key == "volume") {
+        t.volume = parse_float(value) / 65535.0f;
+      }
+    }
+  });
+}
+
+void event_fifo::start(const std::string &path) {
+  if (running.exchange(true))
+    return;
+
+  if (::mkfifo(path.c_str(), 0666) != 0 && errno != EEXIST) {
+    running.store(false);
+    throw std::runtime_error("mkfifo failed: " + path + ": " +
+                             std::strerror(errno));
+  }
+
+  // O_RDWR: vi håller själva en skrivände öppen så att read() aldrig ger EOF
+  // mellan hooks, och open() blockerar inte i väntan på en skrivare.
+  fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    running.store(false);
+    throw std::runtime_error("open failed: " + path + ": " +
+                             std::strerror(errno));
+  }
+  if (::pipe(wake_fd) != 0) {
+    ::close(fd);
+    fd = -1;
+    running.store(false);
+    throw std::runtime_error("pipe failed");
+  }
+
+  thread = std::thread([this]() {
+    std::string pending;
+    char buf[4096];
+
+    while (running.load(std::memory_order_relaxed)) {
+      pollfd fds[2] = {{fd, POLLIN, 0}, {wake_fd[0], POLLIN, 0}};
+      if (::poll(fds, 2, -1) < 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      if (fds[1].revents)
+        break;
+
+      while (true) {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0)
+          break;
+        pending.append(buf, static_cast<size_t>(n));
+      }
+
+      size_t start = 0;
+      for (size_t nl; (nl = pending.find('\n', start)) != std::string::npos;
+           start = nl + 1) {
+        apply_line(store, pending.substr(start, nl - start));
+      }
+      pending.erase(0, start);
+
+      // skydd mot skrivare som aldrig avslutar raden
+      if (pending.size() > 65536)
+        pending.clear();
+    }
+  });
+}
+
+void event_fifo::stop() {
+  if (!running.exchange(false))
+    return;
+
+  if (wake_fd[1] >= 0) {
+    const char c = 0;
+    [[maybe_unused]] const ssize_t n = ::write(wake_fd[1], &c, 1);
+  }
+  if (thread.joinable())
+    thread.join();
+
+  for (int *p : {&fd, &wake_fd[0], &wake_fd[1]}) {
+    if (*p >= 0) {
+      ::close(*p);
+      *p = -1;
+    }
+  }
+}
+
+} // namespace control
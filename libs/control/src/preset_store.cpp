@@ -0,0 +1,191 @@
+#include "control/preset_store.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::vector<std::string> split(const std::string &s, char sep) {
+  std::vector<std::string> out;
+  std::string item;
+  std::istringstream in(s);
+  while (std::getline(in, item, sep)) {
+    if (!item.empty())
+      out.push_back(item);
+  }
+  return out;
+}
+
+} // namespace
+
+namespace control {
+
+bool preset_store::valid_name(const std::string &name) {
+  return !name.empty() && name.size() <= 64 &&
+         std::all_of(name.begin(), name.end(), [](char c) {
+           return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+                  c == '-';
+         });
+}
+
+void preset_store::load() {
+  if (path.empty())
+    return;
+  std::ifstream in(path);
+  if (!in)
+    return;
+
+  std::vector<preset> loaded;
+  std::vector<std::pair<std::string, std::string>> loaded_last;
+  std::string line;
+  int line_no = 0;
+  auto fail = [&](const std::string &what) {
+    throw std::runtime_error(path + ":" + std::to_string(line_no) + ": " +
+                             what);
+  };
+
+  while (std::getline(in, line)) {
+    line_no++;
+    const std::vector<std::string> words = split(line, ' ');
+    if (words.empty() || words[0][0] == '#')
+      continue;
+
+    if (words[0] == "last") {
+      if (words.size() != 3)
+        fail("last zon preset");
+      loaded_last.emplace_back(words[1], words[2]);
+      continue;
+    }
+    if (words[0] != "preset" || words.size() < 2 || !valid_name(words[1]))
+      fail("preset namn nyckel=värde...");
+
+    preset p;
+    p.name = words[1];
+    for (size_t i = 2; i < words.size(); i++) {
+      const size_t eq = words[i].find('=');
+      if (eq == std::string::npos || eq == 0)
+        fail("nyckel=värde: " + words[i]);
+      const std::string key = words[i].substr(0, eq);
+      const std::string value = words[i].substr(eq + 1);
+      if (key == "order") {
+        p.order = split(value, ',');
+        continue;
+      }
+      char *end = nullptr;
+      const float v = std::strtof(value.c_str(), &end);
+      if (end == value.c_str() || *end != '\0')
+        fail("inte ett tal: " + words[i]);
+      p.values.emplace_back(key, v);
+    }
+    loaded.push_back(std::move(p));
+  }
+
+  std::lock_guard<std::mutex> lock(mu);
+  presets = std::move(loaded);
+  last_used = std::move(loaded_last);
+}
+
+std::vector<std::string> preset_store::names() const {
+  std::lock_guard<std::mutex> lock(mu);
+  std::vector<std::string> out;
+  for (const preset &p : presets)
+    out.push_back(p.name);
+  return out;
+}
+
+bool preset_store::find(const std::string &name, preset &out) const {
+  std::lock_guard<std::mutex> lock(mu);
+  for (const preset &p : presets) {
+    if (p.name == name) {
+      out = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+void preset_store::put(const preset &p) {
+  if (!valid_name(p.name))
+    throw std::runtime_error("invalid preset name: " + p.name);
+
+  std::lock_guard<std::mutex> lock(mu);
+  auto it = std::find_if(presets.begin(), presets.end(),
+                         [&](const preset &q) { return q.name == p.name; });
+  if (it != presets.end())
+    *it = p;
+  else
+    presets.push_back(p);
+  save_locked();
+}
+
+bool preset_store::remove(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mu);
+  auto it = std::find_if(presets.begin(), presets.end(),
+                         [&](const preset &q) { return q.name == name; });
+  if (it == presets.end())
+    return false;
+  presets.erase(it);
+  last_used.erase(std::remove_if(last_used.begin(), last_used.end(),
+                                 [&](const auto &l) { return l.second == name; }),
+                  last_used.end());
+  save_locked();
+  return true;
+}
+
+std::string preset_store::last(const std::string &zone) const {
+  std::lock_guard<std::mutex> lock(mu);
+  for (const auto &l : last_used) {
+    if (l.first == zone)
+      return l.second;
+  }
+  return "";
+}
+
+void preset_store::set_last(const std::string &zone, const std::string &name) {
+  std::lock_guard<std::mutex> lock(mu);
+  auto it = std::find_if(last_used.begin(), last_used.end(),
+                         [&](const auto &l) { return l.first == zone; });
+  if (it != last_used.end())
+    it->second = name;
+  else
+    last_used.emplace_back(zone, name);
+  save_locked();
+}
+
+void preset_store::save_locked() const {
+  if (path.empty())
+    return;
+
+  std::ostringstream os;
+  for (const preset &p : presets) {
+    os << "preset " << p.name;
+    if (!p.order.empty()) {
+      os << " order=";
+      for (size_t i = 0; i < p.order.size(); i++)
+        os << (i ? "," : "") << p.order[i];
+    }
+    for (const auto &[key, value] : p.values)
+      os << " " << key << "=" << value;
+    os << "\n";
+  }
+  for (const auto &[zone, name] : last_used)
+    os << "last " << zone << " " << name << "\n";
+
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << os.str();
+    out.flush();
+    if (!out)
+      throw std::runtime_error("cannot write " + tmp);
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("cannot rename " + tmp + " to " + path);
+}
+
+} // namespace control
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <type_traits>
+
+namespace dsp {
+
+// Kanalantal som en loop är specialiserad för; 0 => generisk loop där
+// kanalantalet bara är känt i runtime.
+template <int N> using channel_count = std::integral_constant<int, N>;
+
+// Anropar fn(channel_count<N>{}) med N = 1, 2 eller 8 när alla kanaler i
+// den interleavade bufferten bearbetas (ch == stride), annars med N = 0.
+// Med N > 0 blir både kanalloopen och steget mellan frames konstanter, så
+// kompilatorn kan rulla ut loopen och hålla tillståndet i register.
+template <typename Fn> inline void dispatch_channels(int ch, int stride, Fn &&fn) {
+  if (ch == stride) {
+    switch (ch) {
+    case 1:
+      fn(channel_count<1>{});
+      return;
+    case 2:
+      fn(channel_count<2>{});
+      return;
+    case 8:
+      fn(channel_count<8>{});
+      return;
+    default:
+      break;
+    }
+  }
+  fn(channel_count<0>{});
+}
+
+} // namespace dsp
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "dsp/silence.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace dsp {
+
+// Linkwitz-Riley-delningsfilter för aktiva flervägshögtalare.
+//
+// Till skillnad från effect ändrar crossover antalet kanaler: varje
+// ingångskanal delas i 2-4 vägar som hamnar på egna utgångskanaler, ordnade
+// per väg: [väg0 k0, väg0 k1, ..., väg1 k0, ...].
+//
+// Vägarna räknas parallellt som fyra SIMD-banor genom samma kaskad av
+// biquads. Väg k får för delningspunkt j högpass om j < k, lågpass om j == k
+// och allpass om j > k; allpassen ger samma fasgång som LP+HP i de högre
+// delningarna så att vägarna summerar plant.
+class crossover {
+public:
+  static constexpr int max_ways = 4;
+  static constexpr float max_delay_ms = 10.0f;
+
+  // order: 4 (LR4, 24 dB/okt) eller 8 (LR8, 48 dB/okt).
+  crossover(float sample_rate, int max_channels = 2, int order = 4)
+      : sample_rate_(sample_rate), max_channels_(std::max(1, max_channels)),
+        sections_(order >= 8 ? 4 : 2) {
+    size_t len = 1;
+    const size_t max_delay = static_cast<size_t>(
+        max_delay_ms * 0.001f * sample_rate_ + 1.0f);
+    while (len < max_delay + 1)
+      len <<= 1;
+    delay_mask_ = len - 1;
+
+    const size_t max_stages =
+        static_cast<size_t>(sections_) * static_cast<size_t>(max_ways - 1);
+    stages_.resize(max_stages);
+    state_.assign(static_cast<size_t>(max_channels_) * max_stages,
+                  stage_state{});
+    delay_.assign(static_cast<size_t>(max_channels_) * len * max_ways, 0.0f);
+
+    gain_.fill(1.0f);
+    gain_db_.fill(0.0f);
+    delay_samples_.fill(0);
+    invert_.fill(false);
+
+    set_frequencies({120.0f});
+  }
+
+  int ways() const noexcept { return ways_; }
+  int order() const noexcept { return sections_ == 4 ? 8 : 4; }
+
+  size_t output_channels(int in_channels) const noexcept {
+    return static_cast<size_t>(std::min(in_channels, max_channels_)) *
+           static_cast<size_t>(ways_);
+  }
+
+  // 1-3 delningsfrekvenser, stigande => 2-4 vägar.
+  void set_frequencies(const std::vector<float> &hz) {
+    if (hz.empty())
+      return;
+    const int n = std::min(static_cast<int>(hz.size()), max_ways - 1);
+    std::array<float, max_ways - 1> f{};
+    for (int j = 0; j < n; ++j)
+      f[static_cast<size_t>(j)] =
+          std::clamp(hz[static_cast<size_t>(j)], 20.0f, 0.45f * sample_rate_);
+    // insättningssortering; std::sort på högst tre element ger falska
+    // -Warray-bounds i GCC 12 när funktionen inlinas
+    for (size_t j = 1; j < static_cast<size_t>(n); ++j)
+      for (size_t k = j; k > 0 && f[k] < f[k - 1]; --k)
+        std::swap(f[k], f[k - 1]);
+
+    if (n + 1 == ways_ && std::equal(f.begin(), f.begin() + n, freq_.begin()))
+      return;
+
+    ways_ = n + 1;
+    freq_ = f;
+    update_coefficients();
+  }
+
+  // Anropas från samma tråd som process(), som eq3band. Högst 0 dB:
+  // filtret ligger efter limitern och får inte lägga till nivå.
+  void set_gain_db(int way, float db) {
+    if (way < 0 || way >= max_ways)
+      return;
+    db = std::clamp(db, -24.0f, 0.0f);
+    if (db == gain_db_[static_cast<size_t>(way)])
+      return;
+    gain_db_[static_cast<size_t>(way)] = db;
+    gain_[static_cast<size_t>(way)] = std::pow(10.0f, db / 20.0f);
+  }
+
+  void set_delay_ms(int way, float ms) {
+    if (way < 0 || way >= max_ways)
+      return;
+    ms = std::clamp(ms, 0.0f, max_delay_ms);
+    delay_samples_[static_cast<size_t>(way)] =
+        std::min(static_cast<size_t>(ms * 0.001f * sample_rate_ + 0.5f),
+                 delay_mask_);
+  }
+
+  void set_inverted(int way, bool inverted) {
+    if (way < 0 || way >= max_ways)
+      return;
+    invert_[static_cast<size_t>(way)] = inverted;
+  }
+
+  // Filterminnet är tyst och inget hörbart väntar i tidsjusteringen.
+  bool tail_decayed() const noexcept {
+    for (const stage_state &z : state_) {
+      if (!is_silent(z.z1, max_ways) || !is_silent(z.z2, max_ways))
+        return false;
+    }
+    const size_t len = delay_mask_ + 1;
+    for (int c = 0; c < max_channels_; ++c) {
+      const float *dl = &delay_[static_cast<size_t>(c) * len * max_ways];
+      for (size_t k = 0; k < max_ways; ++k) {
+        const float *line = dl + k * len;
+        for (size_t i = 1; i <= delay_samples_[k]; ++i) {
+          if (!is_silent(&line[(write_idx_ - i) & delay_mask_], 1))
+            return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // out måste rymma frames * output_channels(in_channels) samples.
+  void process(const float *in, float *out, size_t frames,
+               int in_channels) noexcept {
+    if (!in || !out || frames == 0 || in_channels <= 0)
+      return;
+
+    const int ch = std::min(in_channels, max_channels_);
+    const size_t out_ch = output_channels(in_channels);
+    const size_t stages =
+        static_cast<size_t>(sections_) * static_cast<size_t>(ways_ - 1);
+    const size_t len = delay_mask_ + 1;
+
+    alignas(16) float g[max_ways];
+    for (size_t k = 0; k < max_ways; ++k)
+      g[k] = invert_[k] ? -gain_[k] : gain_[k];
+
+    for (int c = 0; c < ch; ++c) {
+      stage_state *st = &state_[static_cast<size_t>(c) * stages_.size()];
+      float *dl = &delay_[static_cast<size_t>(c) * len * max_ways];
+      size_t w = write_idx_;
+
+      for (size_t f = 0; f < frames; ++f) {
+        const float x =
+            in[f * static_cast<size_t>(in_channels) + static_cast<size_t>(c)];
+
+        alignas(16) float v[max_ways];
+        for (size_t k = 0; k < max_ways; ++k)
+          v[k] = x;
+
+        // Transponerad direktform II, en bana per väg
+        for (size_t s = 0; s < stages; ++s) {
+          const stage &q = stages_[s];
+          stage_state &z = st[s];
+          for (size_t k = 0; k < max_ways; ++k) {
+            const float y = q.b0[k] * v[k] + z.z1[k];
+            z.z1[k] = q.b1[k] * v[k] - q.a1[k] * y + z.z2[k];
+            z.z2[k] = q.b2[k] * v[k] - q.a2[k] * y;
+            v[k] = y;
+          }
+        }
+
+        for (size_t k = 0; k < max_ways; ++k)
+          v[k] *= g[k];
+
+        // Tidsjustering per väg
+        float *o = out + f * out_ch;
+        for (size_t k = 0; k < static_cast<size_t>(ways_); ++k) {
+          float *line = dl + k * len;
+          line[w] = v[k];
+          o[k * static_cast<size_t>(ch) + static_cast<size_t>(c)] =
+              line[(w - delay_samples_[k]) & delay_mask_];
+        }
+        w = (w + 1) & delay_mask_;
+      }
+    }
+
+    write_idx_ = (write_idx_ + frames) & delay_mask_;
+  }
+
+private:
+  struct stage {
+    alignas(16) float b0[max_ways];
+    alignas(16) float b1[max_ways];
+    alignas(16) float b2[max_ways];
+    alignas(16) float a1[max_ways];
+    alignas(16) float a2[max_ways];
+  };
+
+  struct stage_state {
+    alignas(16) float z1[max_ways]{};
+    alignas(16) float z2[max_ways]{};
+  };
+
+  enum class kind { lowpass, highpass, allpass, identity };
+
+  // RBJ cookbook
+  static void design(stage &q, size_t lane, kind t, float sample_rate,
+                     float hz, float qf) {
+    if (t == kind::identity) {
+      q.b0[lane] = 1.0f;
+      q.b1[lane] = q.b2[lane] = q.a1[lane] = q.a2[lane] = 0.0f;
+      return;
+    }
+
+    const double w0 = 2.0 * M_PI * hz / sample_rate;
+    const double cw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * qf);
+    const double a0 = 1.0 + alpha;
+
+    double b0, b1, b2;
+    switch (t) {
+    case kind::lowpass:
+      b0 = b2 = (1.0 - cw) * 0.5;
+      b1 = 1.0 - cw;
+      break;
+    case kind::highpass:
+      b0 = b2 = (1.0 + cw) * 0.5;
+      b1 = -(1.0 + cw);
+      break;
+    default:
+      b0 = 1.0 - alpha;
+      b1 = -2.0 * cw;
+      b2 = 1.0 + alpha;
+      break;
+    }
+
+    q.b0[lane] = static_cast<float>(b0 / a0);
+    q.b1[lane] = static_cast<float>(b1 / a0);
+    q.b2[lane] = static_cast<float>(b2 / a0);
+    q.a1[lane] = static_cast<float>(-2.0 * cw / a0);
+    q.a2[lane] = static_cast<float>((1.0 - alpha) / a0);
+  }
+
+  void update_coefficients() {
+    // LR4 = Butterworth 2:a ordningen i kvadrat, LR8 = Butterworth 4:e
+    // ordningen i kvadrat. Allpassen motsvarar en Butterworth-nämnare.
+    static constexpr float q_lr4[] = {0.70710678f};
+    static constexpr float q_lr8[] = {0.54119610f, 1.30656296f};
+    const float *qs = sections_ == 4 ? q_lr8 : q_lr4;
+    const size_t nq = sections_ == 4 ? 2 : 1;
+
+    for (size_t j = 0; j < static_cast<size_t>(ways_ - 1); ++j) {
+      for (size_t s = 0; s < static_cast<size_t>(sections_); ++s) {
+        stage &q = stages_[j * static_cast<size_t>(sections_) + s];
+        const float qf = qs[s % nq];
+        for (size_t k = 0; k < max_ways; ++k) {
+          kind t = kind::allpass;
+          if (k >= static_cast<size_t>(ways_))
+            t = kind::identity;
+          else if (j < k)
+            t = kind::highpass;
+          else if (j == k)
+            t = kind::lowpass;
+          else if (s >= nq)
+            t = kind::identity; // allpassen behöver bara halva kaskaden
+          design(q, k, t, sample_rate_, freq_[j], qf);
+        }
+      }
+    }
+
+    std::fill(state_.begin(), state_.end(), stage_state{});
+  }
+
+  float sample_rate_;
+  int max_channels_;
+  int sections_; // biquads per delningspunkt
+
+  int ways_{0};
+  std::array<float, max_ways - 1> freq_{};
+
+  std::vector<stage> stages_;
+  std::vector<stage_state> state_;
+
+  std::array<float, max_ways> gain_{};
+  std::array<float, max_ways> gain_db_{};
+  std::array<size_t, max_ways> delay_samples_{};
+  std::array<bool, max_ways> invert_{};
+
+  std::vector<float> delay_;
+  size_t delay_mask_{0};
+  size_t write_idx_{0};
+};
+
+} // namespace dsp
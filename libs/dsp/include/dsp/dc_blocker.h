@@ -1,43 +1,92 @@
 #pragma once
 
+#include "dsp/channels.h"
 #include "dsp/effect.h"
+#include "dsp/silence.h"
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
 namespace dsp {
 class dc_blocker final : public effect {
 public:
-  dc_blocker(double hz = 10.0) { set_cutoff(hz); }
+  dc_blocker(double hz = 10.0, int max_channels = 2) : cutoff_hz(hz) {
+    prepare(44100, max_channels, 0);
+  }
+
+  void prepare(int rate, int channels, size_t) override {
+    sample_rate = static_cast<double>(std::max(1, rate));
+    x_prev.assign(static_cast<size_t>(std::max(1, channels)), 0.0f);
+    y_prev.assign(x_prev.size(), 0.0f);
+    update();
+  }
 
   void set_cutoff(double hz) {
-    // R = e^(-2*pi*fc/fs)
-    r = static_cast<float>(std::exp(-2.0 * M_PI * hz / sample_rate));
+    if (hz == cutoff_hz)
+      return;
+    cutoff_hz = hz;
+    update();
   }
 
+  const char *name() const noexcept override { return "dc_blocker"; }
+
   void process(float *buf, size_t frames, int ch) noexcept override {
     if (ch <= 0) {
       return;
     }
 
-    for (size_t f = 0; f < frames; f++) {
-      for (int c = 0; c < ch; c++) {
-        const size_t i = f * static_cast<size_t>(ch) + c;
+    const int chn = std::min(ch, static_cast<int>(x_prev.size()));
+    dispatch_channels(chn, ch, [&](auto n) {
+      run<decltype(n)::value>(buf, frames, chn, ch);
+    });
+  }
+
+  bool tail_decayed() const noexcept override {
+    return is_silent(x_prev.data(), x_prev.size()) &&
+           is_silent(y_prev.data(), y_prev.size());
+  }
 
-        const float x = buf[i];
-        const float y = x - x_prev[c] + r * y_prev[c];
-        x_prev[c] = x;
-        y_prev[c] = y;
+private:
+  void update() {
+    // R = e^(-2*pi*fc/fs)
+    r = static_cast<float>(std::exp(-2.0 * M_PI * cutoff_hz / sample_rate));
+  }
+
+  // N > 0: tillståndet kopieras till lokala arrayer som hålls i register
+  template <int N>
+  void run(float *buf, size_t frames, int chn, int ch) noexcept {
+    const int cn = N > 0 ? N : chn;
+    const size_t stride = N > 0 ? N : static_cast<size_t>(ch);
+
+    float xl[N > 0 ? N : 1], yl[N > 0 ? N : 1];
+    float *xp = N > 0 ? xl : x_prev.data();
+    float *yp = N > 0 ? yl : y_prev.data();
+    if constexpr (N > 0) {
+      std::copy_n(x_prev.data(), N, xl);
+      std::copy_n(y_prev.data(), N, yl);
+    }
 
-        buf[i] = y;
+    for (size_t f = 0; f < frames; f++) {
+      float *frame = buf + f * stride;
+      for (int c = 0; c < cn; c++) {
+        const float x = frame[c];
+        const float y = x - xp[c] + r * yp[c];
+        xp[c] = x;
+        yp[c] = y;
+        frame[c] = y;
       }
     }
+
+    if constexpr (N > 0) {
+      std::copy_n(xl, N, x_prev.data());
+      std::copy_n(yl, N, y_prev.data());
+    }
   }
 
-private:
-  // std::vector<float> x_prev, y_prev;
-  float x_prev[2]{0.0, 0.0}, y_prev[2]{0.0, 0.0};
+  std::vector<float> x_prev, y_prev;
 
-  const double sample_rate = 44100.0;
+  double sample_rate = 44100.0;
+  double cutoff_hz = 10.0;
   float r{0.995f};
 };
-} // namespace dsp
\ No newline at end of file
+} // namespace dsp
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace dsp {
+
+// Fördröjningslinjer, en per kanal, med bråkdelsfördröjning.
+//
+// Storleken är en potens av två så att index maskas i stället för modulo.
+// Efter varje linje ligger en kopia av dess första guard sampel, så att en
+// interpolerande läsning alltid kan ta sina 2-4 grannar i följd utan att
+// kontrollera wrap; bara skrivningen vet om kopian.
+//
+// Fördröjningen räknas från skrivpositionen: read(c, d) ger samplet som
+// skrevs d frames före det som skrivs härnäst. I en återkopplad loop
+// (läs, skriv, advance) måste d vara minst min_delay för metoden. För
+// framkopplade effekter (chorus, flanger, tidsjustering) skrivs hela
+// blocket först och läses sedan med en fördröjning per sampel, där frame
+// f räknas från skrivpositionen + f; då räcker d >= 0 för linjär läsning.
+class delay_line {
+public:
+  static constexpr size_t guard = 4;
+
+  enum class interpolation { linear, lagrange, allpass };
+
+  // Minsta fördröjning som bara läser skrivna sampel i en återkopplad loop
+  static constexpr float min_delay(interpolation i) noexcept {
+    return i == interpolation::linear ? 1.0f : 2.0f;
+  }
+
+  // Anropas utanför ljudtråden. max_block: största block som skrivs med
+  // write_block innan det läses, 0 för enbart läs/skriv per frame.
+  void prepare(size_t max_delay, int channels, size_t max_block = 0) {
+    channels_ = std::max(1, channels);
+    size_t cap = 1;
+    while (cap < max_delay + max_block + 3)
+      cap <<= 1;
+    mask_ = cap - 1;
+    max_delay_ = static_cast<float>(max_delay);
+    stride_ = cap + guard;
+    lines_.assign(static_cast<size_t>(channels_) * stride_, 0.0f);
+    allpass_.assign(static_cast<size_t>(channels_), allpass_state{});
+    pos_ = 0;
+  }
+
+  void clear() noexcept {
+    std::fill(lines_.begin(), lines_.end(), 0.0f);
+    std::fill(allpass_.begin(), allpass_.end(), allpass_state{});
+  }
+
+  // Längsta fördröjning i frames
+  float max_delay() const noexcept { return max_delay_; }
+  size_t capacity() const noexcept { return mask_ + 1; }
+
+  void write(int c, float x) noexcept {
+    float *line = &lines_[static_cast<size_t>(c) * stride_];
+    const size_t w = pos_ & mask_;
+    line[w] = x;
+    if (w < guard)
+      line[w + mask_ + 1] = x;
+  }
+
+  // n frames från in (stride mellan samplen) på skrivpositionen och framåt,
+  // utan att flytta den
+  void write_block(int c, const float *in, size_t n,
+                   size_t stride = 1) noexcept {
+    float *line = &lines_[static_cast<size_t>(c) * stride_];
+    for (size_t f = 0; f < n; ++f) {
+      const size_t w = (pos_ + f) & mask_;
+      line[w] = in[f * stride];
+      if (w < guard)
+        line[w + mask_ + 1] = in[f * stride];
+    }
+  }
+
+  void advance(size_t frames = 1) noexcept { pos_ += frames; }
+
+  float read(int c, float delay) const noexcept {
+    return read_linear(c, 0, delay);
+  }
+
+  // Linjär interpolation. Fördröjningen clampas till [0, max_delay].
+  float read_linear(int c, size_t frame, float delay) const noexcept {
+    const float *line = &lines_[static_cast<size_t>(c) * stride_];
+    size_t i;
+    float frac;
+    split(frame, delay, 1, i, frac);
+    // frac = 0 ger exakt det nyare samplet
+    return line[i + 1] + frac * (line[i] - line[i + 1]);
+  }
+
+  // Lagrange av tredje ordningen över fyra grannar; plattare frekvensgång
+  // än linjär, för modulerad fördröjning.
+  float read_lagrange(int c, size_t frame, float delay) const noexcept {
+    const float *line = &lines_[static_cast<size_t>(c) * stride_];
+    size_t i;
+    float frac;
+    split(frame, delay, 2, i, frac);
+    // punkterna -1, 0, 1, 2 (äldst först), läsläge t mellan 0 och 1
+    const float t = 1.0f - frac;
+    const float tm1 = t - 1.0f, tm2 = t - 2.0f, tp1 = t + 1.0f;
+    const float h0 = -t * tm1 * tm2 * (1.0f / 6.0f);
+    const float h1 = tp1 * tm1 * tm2 * 0.5f;
+    const float h2 = -tp1 * t * tm2 * 0.5f;
+    const float h3 = tp1 * t * tm1 * (1.0f / 6.0f);
+    return h0 * line[i] + h1 * line[i + 1] + h2 * line[i + 2] +
+           h3 * line[i + 3];
+  }
+
+  // Första ordningens allpass (Thiran). Platt amplitud i hela bandet men
+  // har tillstånd, så den läses en frame i taget, en gång per kanal och
+  // frame, och passar för fördröjningar som ändras långsamt.
+  float read_allpass(int c, size_t frame, float delay) noexcept {
+    const float *line = &lines_[static_cast<size_t>(c) * stride_];
+    // heltalsdel så att bråkdelen hamnar i [0.5, 1.5), där a är stabil och
+    // fasfelet minst
+    const float d = std::clamp(delay, 2.0f, max_delay_);
+    const float di = std::floor(d - 0.5f);
+    const float frac = d - di;
+    const size_t u = (pos_ + frame - static_cast<size_t>(di)) & mask_;
+    const float a = (1.0f - frac) / (1.0f + frac);
+
+    allpass_state &s = allpass_[static_cast<size_t>(c)];
+    const float x = line[u];
+    const float y = a * x + s.x1 - a * s.y1;
+    s.x1 = x;
+    s.y1 = y;
+    return y;
+  }
+
+  // Ett block fördröjt per sampel: out[f] = linjen vid frame f minus
+  // delay[f]. Loopen är grenfri och kan vektoriseras.
+  void read_block(int c, const float *delay, float *out, size_t n,
+                  interpolation mode = interpolation::linear) noexcept {
+    switch (mode) {
+    case interpolation::linear:
+      for (size_t f = 0; f < n; ++f)
+        out[f] = read_linear(c, f, delay[f]);
+      break;
+    case interpolation::lagrange:
+      for (size_t f = 0; f < n; ++f)
+        out[f] = read_lagrange(c, f, delay[f]);
+      break;
+    case interpolation::allpass:
+      for (size_t f = 0; f < n; ++f)
+        out[f] = read_allpass(c, f, delay[f]);
+      break;
+    }
+  }
+
+private:
+  struct allpass_state {
+    float x1 = 0.0f;
+    float y1 = 0.0f;
+  };
+
+  // Index för den äldsta av grannarna och avståndet från den näst äldsta
+  // (linjär: i och i + 1; Lagrange: i .. i + 3 med läsläget mellan i + 1
+  // och i + 2). older = antal grannar äldre än läsläget.
+  void split(size_t frame, float delay, size_t older, size_t &i,
+             float &frac) const noexcept {
+    const float d = std::clamp(delay, 0.0f, max_delay_);
+    const float di = std::floor(d);
+    frac = d - di;
+    i = (pos_ + frame - static_cast<size_t>(di) - older) & mask_;
+  }
+
+  int channels_{1};
+  size_t mask_{0};
+  size_t stride_{guard + 1};
+  float max_delay_{0.0f};
+  size_t pos_{0};
+  std::vector<float> lines_;
+  std::vector<allpass_state> allpass_;
+};
+
+} // namespace dsp
@@ -8,6 +8,8 @@ namespace dsp {
 
 class distortion final : public effect {
 public:
+  const char *name() const noexcept override { return "distortion"; }
+
   void process(float *buf, size_t frames, int ch) noexcept override {
     if (ch <= 0) {
       return;
@@ -26,6 +28,9 @@ public:
     }
   }
 
+  // utan tillstånd: tanh(0) = 0
+  bool tail_decayed() const noexcept override { return true; }
+
 private:
   float drive = 10.0; // [1, 20]
   float mix = 1.0;    // [0, 1]
@@ -7,8 +7,29 @@ namespace dsp {
 class effect {
 public:
   virtual ~effect() = default;
+
+  // Anropas innan ljudet startar och när strömformatet ändras, aldrig från
+  // ljudtråden. Effekter med tillstånd allokerar om för channels kanaler
+  // och räknar om koefficienter för sample_rate. max_block är största
+  // antalet frames som process() får.
+  virtual void prepare(int sample_rate, int channels, size_t max_block) {
+    (void)sample_rate;
+    (void)channels;
+    (void)max_block;
+  }
+
   virtual void process(float *interleaved, size_t frames,
                        int channels) noexcept = 0;
+
+  // Namn i spårningen (GET /trace), en strängliteral
+  virtual const char *name() const noexcept { return "effect"; }
+
+  // Sant när internt tillstånd (fördröjningslinjer, filterminne, envelopes)
+  // har klingat av under silence_threshold, så att tyst in ger tyst ut och
+  // process() kan hoppas över utan hörbar skillnad. Effekter utan tillstånd
+  // returnerar true; standard är false så att ingen effekt hoppas över av
+  // misstag.
+  virtual bool tail_decayed() const noexcept { return false; }
 };
 
-} // namespace dsp
\ No newline at end of file
+} // namespace dsp
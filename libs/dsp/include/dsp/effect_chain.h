@@ -1,24 +1,60 @@
 #pragma once
 
 #include "dsp/effect.h"
+#include "dsp/silence.h"
 
+#include "trace/trace.h"
+
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 namespace dsp {
 
+// Viloläge: när ingången är tyst och alla effekters svansar har klingat av
+// hoppar kedjan över effekterna och skriver nollor. Tillståndet som lämnas
+// kvar ligger under silence_threshold, så när signalen kommer tillbaka
+// fortsätter effekterna därifrån utan hörbart hopp.
 class EffectChain {
 public:
   void add(std::unique_ptr<effect> fx) { fx_list.push_back(std::move(fx)); }
 
+  void prepare(int sample_rate, int channels, size_t max_block) {
+    for (auto &e : fx_list) {
+      e->prepare(sample_rate, channels, max_block);
+    }
+    idle_ = false;
+  }
+
   void process(float *buf, size_t frames, int ch) noexcept {
+    const size_t samples = frames * static_cast<size_t>(ch);
+    const bool silent = is_silent(buf, samples);
+
+    if (silent && idle_) {
+      std::fill(buf, buf + samples, 0.0f);
+      return;
+    }
+    idle_ = false;
+
     for (auto &e : fx_list) {
+      trace::scope t(e->name());
       e->process(buf, frames, ch);
     }
+
+    // Svansarna kontrolleras bara medan ingången är tyst och kedjan ännu
+    // inte vilar; i viloläge ändras de inte.
+    if (silent) {
+      idle_ = std::all_of(fx_list.begin(), fx_list.end(),
+                          [](const auto &e) { return e->tail_decayed(); });
+    }
   }
 
+  // Sant om senaste blocket hoppades över eller ledde till viloläge.
+  bool idle() const noexcept { return idle_; }
+
 private:
   std::vector<std::unique_ptr<effect>> fx_list;
+  bool idle_{false};
 };
 
-} // namespace dsp
\ No newline at end of file
+} // namespace dsp
@@ -1,67 +1,88 @@
 #pragma once
 
+#include "dsp/channels.h"
 #include "dsp/effect.h"
+#include "dsp/silence.h"
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 namespace dsp {
 
 class eq3band final : public effect {
 public:
-  explicit eq3band(float sample_rate_hz /*, int channels = 2*/)
-      : sample_rate(sample_rate_hz) /*, channels(channels)*/ {
+  explicit eq3band(float sample_rate_hz, int max_channels = 2) {
+    prepare(static_cast<int>(sample_rate_hz), max_channels, 0);
+  }
+
+  void prepare(int rate, int max_channels, size_t) override {
+    sample_rate = static_cast<float>(std::max(1, rate));
+    channels = std::max(1, max_channels);
+    low.resize(channels);
+    mid.resize(channels);
+    high.resize(channels);
     update_all();
   }
 
   void set_low_db(float db) {
-    low_db = std::clamp(db, -12.0f, 12.0f);
+    db = std::clamp(db, -12.0f, 12.0f);
+    if (db == low_db)
+      return;
+    low_db = db;
     update_low();
   }
 
   void set_mid_db(float db) {
-    mid_db = std::clamp(db, -12.0f, 12.0f);
+    db = std::clamp(db, -12.0f, 12.0f);
+    if (db == mid_db)
+      return;
+    mid_db = db;
     update_mid();
   }
 
   void set_high_db(float db) {
-    high_db = std::clamp(db, -12.0f, 12.0f);
+    db = std::clamp(db, -12.0f, 12.0f);
+    if (db == high_db)
+      return;
+    high_db = db;
     update_high();
   }
 
+  const char *name() const noexcept override { return "eq3band"; }
+
   void process(float *interleaved, size_t frames, int ch) noexcept override {
     if (ch <= 0) {
       return;
     }
 
-    const int chn = std::min(ch, 2);
-    for (size_t f = 0; f < frames; f++) {
-      for (int c = 0; c < chn; c++) {
-        const size_t i = f * static_cast<size_t>(ch) + c;
-        float x = interleaved[i];
-        x = low.process(x, c);
-        x = mid.process(x, c);
-        x = high.process(x, c);
-        interleaved[i] = x;
-      }
-    }
+    const int chn = std::min(ch, channels);
+    dispatch_channels(chn, ch, [&](auto n) {
+      run<decltype(n)::value>(interleaved, frames, chn, ch);
+    });
+  }
+
+  bool tail_decayed() const noexcept override {
+    return low.quiet() && mid.quiet() && high.quiet();
   }
 
 private:
   struct biquad {
     float b0{1.0f}, b1{0.0f}, b2{0.0f}, a1{0.0f}, a2{0.0f};
-    float z1[2]{0.0f, 0.0f};
-    float z2[2]{0.0f, 0.0f};
+    std::vector<float> z1;
+    std::vector<float> z2;
 
-    void reset() {
-      z1[0] = z1[1] = 0.0f;
-      z2[0] = z2[1] = 0.0f;
+    void resize(int channels) {
+      z1.assign(static_cast<size_t>(channels), 0.0f);
+      z2.assign(static_cast<size_t>(channels), 0.0f);
     }
 
-    inline float process(float x, int ch) {
-      float y = b0 * x + z1[ch];
-      z1[ch] = b1 * x - a1 * y + z2[ch];
-      z2[ch] = b2 * x - a2 * y;
-      return y;
+    bool quiet() const noexcept {
+      return is_silent(z1.data(), z1.size()) && is_silent(z2.data(), z2.size());
+    }
+
+    void reset() {
+      std::fill(z1.begin(), z1.end(), 0.0f);
+      std::fill(z2.begin(), z2.end(), 0.0f);
     }
 
     void set_peaking(float sample_rate, float freq_hz, float q, float db) {
@@ -124,6 +145,67 @@ private:
     }
   };
 
+  // Tre biquads i serie per kanal. Med N > 0 ligger tillståndet och
+  // framen i lokala arrayer med konstant längd; kanalerna är oberoende, så
+  // kanalloopen blir SIMD över kanalerna och inget går via minnet mellan
+  // sektionerna.
+  template <int N>
+  void run(float *buf, size_t frames, int chn, int ch) noexcept {
+    biquad *const sections[3] = {&low, &mid, &high};
+    float b0[3], b1[3], b2[3], a1[3], a2[3];
+    for (int s = 0; s < 3; s++) {
+      b0[s] = sections[s]->b0;
+      b1[s] = sections[s]->b1;
+      b2[s] = sections[s]->b2;
+      a1[s] = sections[s]->a1;
+      a2[s] = sections[s]->a2;
+    }
+
+    if constexpr (N > 0) {
+      float z1[3][N], z2[3][N];
+      for (int s = 0; s < 3; s++) {
+        std::copy_n(sections[s]->z1.data(), N, z1[s]);
+        std::copy_n(sections[s]->z2.data(), N, z2[s]);
+      }
+
+      for (size_t f = 0; f < frames; f++) {
+        float *frame = buf + f * N;
+        float x[N];
+        std::copy_n(frame, N, x);
+        for (int s = 0; s < 3; s++) {
+          for (int c = 0; c < N; c++) {
+            const float y = b0[s] * x[c] + z1[s][c];
+            z1[s][c] = b1[s] * x[c] - a1[s] * y + z2[s][c];
+            z2[s][c] = b2[s] * x[c] - a2[s] * y;
+            x[c] = y;
+          }
+        }
+        std::copy_n(x, N, frame);
+      }
+
+      for (int s = 0; s < 3; s++) {
+        std::copy_n(z1[s], N, sections[s]->z1.data());
+        std::copy_n(z2[s], N, sections[s]->z2.data());
+      }
+    } else {
+      for (size_t f = 0; f < frames; f++) {
+        float *frame = buf + f * static_cast<size_t>(ch);
+        for (int c = 0; c < chn; c++) {
+          float x = frame[c];
+          for (int s = 0; s < 3; s++) {
+            float *z1 = sections[s]->z1.data();
+            float *z2 = sections[s]->z2.data();
+            const float y = b0[s] * x + z1[c];
+            z1[c] = b1[s] * x - a1[s] * y + z2[c];
+            z2[c] = b2[s] * x - a2[s] * y;
+            x = y;
+          }
+          frame[c] = x;
+        }
+      }
+    }
+  }
+
   void update_all() {
     update_low();
     update_mid();
@@ -138,8 +220,8 @@ private:
     high.set_high_shelf(sample_rate, high_freq_hz, high_db);
   }
 
-  float sample_rate;
-  // int channels;
+  float sample_rate{44100.0f};
+  int channels{2};
 
   float low_db{0.0f};
   float mid_db{0.0f};
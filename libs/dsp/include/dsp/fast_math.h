@@ -0,0 +1,35 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+namespace dsp {
+
+// Billiga approximationer för log-domänberäkningar i ljudtråden. Felet är
+// under ~0.005 (log2) resp. ~0.07 % (exp2), vilket räcker för gainberäkning
+// men inte för filterkoefficienter.
+
+// log2(x) för x > 0. Exponenten tas direkt ur IEEE-bitarna och mantissan
+// [1, 2) approximeras med ett andragradspolynom.
+inline float fast_log2(float x) noexcept {
+  const uint32_t bits = std::bit_cast<uint32_t>(x);
+  const float e = static_cast<float>(static_cast<int32_t>((bits >> 23) & 0xff) -
+                                     127);
+  const float m = std::bit_cast<float>((bits & 0x007fffffu) | 0x3f800000u);
+  return e + (-0.34484843f * m + 2.02466578f) * m - 1.67487759f;
+}
+
+// 2^x, giltig för ungefär -126 < x < 127.
+inline float fast_exp2(float x) noexcept {
+  const float fl = static_cast<float>(static_cast<int32_t>(x) - (x < 0.0f));
+  const float f = x - fl; // [0, 1)
+  const float p =
+      1.0f + f * (0.69583356f + f * (0.22606716f + f * 0.07944023f));
+  const int32_t e = static_cast<int32_t>(fl) + 127;
+  return std::bit_cast<float>(static_cast<uint32_t>(e) << 23) * p;
+}
+
+// dB <-> log2: 20*log10(2)
+constexpr float db_per_log2 = 6.0205999f;
+
+} // namespace dsp
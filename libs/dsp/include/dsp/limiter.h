@@ -0,0 +1,411 @@
+#pragma once
+
+#include "dsp/channels.h"
+#include "dsp/effect.h"
+#include "dsp/silence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace dsp {
+
+// Look-ahead brickwall limiter, tänkt att ligga sist i kedjan.
+//
+// Signalen fördröjs med lookahead-fönstret (L samples). Nödvändig gain per
+// sample tas som glidande minimum över L+1 samples (monoton kö, amorterat
+// O(1)) och jämnas sedan ut med ett boxfilter av längd L, så att gain har
+// nått målet exakt när toppen lämnar fördröjningen. Release är en enpolig
+// återgång uppåt.
+//
+// Byte av lookahead eller true peak under gång behåller fördröjningen och
+// historiken: läspositionen flyttas, kön och boxen byggs om från den
+// sparade nödvändiga gain och den gamla läspositionen tonas ut.
+class limiter final : public effect {
+public:
+  static constexpr float min_lookahead_ms = 1.0f;
+  static constexpr float max_lookahead_ms = 5.0f;
+
+  explicit limiter(int sample_rate = 44100, int max_channels = 2) {
+    design_true_peak_filter();
+
+    set_ceiling_db(-1.0f);
+    set_lookahead_ms(2.0f);
+    set_release_ms(80.0f);
+    set_true_peak(true);
+    prepare(sample_rate, max_channels, 0);
+  }
+
+  void prepare(int sample_rate, int max_channels, size_t) override {
+    sample_rate_ = std::max(1, sample_rate);
+    max_channels_ = std::max(1, max_channels);
+
+    const size_t max_window =
+        ms_to_frames(max_lookahead_ms) + static_cast<size_t>(tp_delay);
+
+    // Fönster och fördröjning delar potens-av-två-storlek => mask i stället
+    // för modulo i den inre loopen. Historiken räcker för att bygga om kön
+    // och boxen för ett nytt fönster (se retune).
+    size_t cap = 1;
+    while (cap < 2 * max_window + 1)
+      cap <<= 1;
+    mask_ = cap - 1;
+
+    delay_.assign(static_cast<size_t>(max_channels_) * cap, 0.0f);
+    box_.assign(cap, 1.0f);
+    req_.assign(cap, 1.0f);
+    dq_idx_.assign(cap, 0);
+    dq_val_.assign(cap, 1.0f);
+    tp_hist_.assign(static_cast<size_t>(max_channels_) * 2 * tp_taps, 0.0f);
+
+    reset(ms_to_frames(lookahead_ms_.load(std::memory_order_relaxed)),
+          true_peak_.load(std::memory_order_relaxed));
+  }
+
+  void set_ceiling_db(float db) noexcept {
+    ceiling_db_.store(std::clamp(db, -24.0f, 0.0f), std::memory_order_relaxed);
+  }
+  void set_lookahead_ms(float ms) noexcept {
+    lookahead_ms_.store(std::clamp(ms, min_lookahead_ms, max_lookahead_ms),
+                        std::memory_order_relaxed);
+  }
+  void set_release_ms(float ms) noexcept {
+    release_ms_.store(std::clamp(ms, 1.0f, 1000.0f),
+                      std::memory_order_relaxed);
+  }
+  void set_true_peak(bool on) noexcept {
+    true_peak_.store(on, std::memory_order_relaxed);
+  }
+
+  // Total fördröjning genom limitern i frames (lookahead + ev. true peak).
+  size_t latency_frames() const noexcept {
+    return lookahead_ + (tp_on_ ? static_cast<size_t>(tp_delay) : 0);
+  }
+
+  // Största gain-reduktionen i senaste blocket (>= 0 dB), för mätning.
+  float gain_reduction_db() const noexcept {
+    return gain_reduction_db_.load(std::memory_order_relaxed);
+  }
+
+  // Tyst när fördröjningen bara innehåller tystnad och gain har släppt
+  // tillbaka till 1, annars skulle en överhoppad release märkas vid start.
+  bool tail_decayed() const noexcept override {
+    if (xfade_left_ > 0 || env_ < 1.0f - 1e-4f ||
+        box_sum_ < static_cast<double>(lookahead_) - 1e-3)
+      return false;
+    if (tp_on_ && !is_silent(tp_hist_.data(), tp_hist_.size()))
+      return false;
+
+    // samplen som ännu inte har lämnat fördröjningen
+    const size_t delay = latency_frames();
+    const size_t cap = mask_ + 1;
+    for (int c = 0; c < max_channels_; ++c) {
+      const float *line = &delay_[static_cast<size_t>(c) * cap];
+      for (size_t i = 1; i <= delay; ++i) {
+        if (!is_silent(&line[(n_ - i) & mask_], 1))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  const char *name() const noexcept override { return "limiter"; }
+
+  void process(float *interleaved, size_t frames,
+               int channels) noexcept override {
+    if (!interleaved || frames == 0 || channels <= 0)
+      return;
+
+    const int ch = std::min(channels, max_channels_);
+
+    // Läs parametrar en gång per block
+    const size_t lookahead =
+        ms_to_frames(lookahead_ms_.load(std::memory_order_relaxed));
+    const bool tp = true_peak_.load(std::memory_order_relaxed);
+    const float ceiling =
+        std::pow(10.0f, ceiling_db_.load(std::memory_order_relaxed) / 20.0f);
+    if (lookahead != lookahead_ || tp != tp_on_)
+      retune(lookahead, tp, ceiling);
+
+    const float release =
+        std::exp(-1.0f / (0.001f * release_ms_.load(std::memory_order_relaxed) *
+                          static_cast<float>(sample_rate_)));
+
+    float min_gain = 1.0f;
+    dispatch_channels(ch, channels, [&](auto n) {
+      min_gain = run<decltype(n)::value>(interleaved, frames, ch, channels,
+                                         ceiling, release);
+    });
+
+    gain_reduction_db_.store(-20.0f * std::log10(std::max(min_gain, 1e-6f)),
+                             std::memory_order_relaxed);
+  }
+
+private:
+  // 4x oversampling för true peak: polyfas-FIR med 8 taps per fas.
+  static constexpr int tp_phases = 4;
+  static constexpr int tp_taps = 8;
+  static constexpr int tp_delay = tp_taps / 2;
+
+  size_t ms_to_frames(float ms) const noexcept {
+    const float clamped = std::clamp(ms, min_lookahead_ms, max_lookahead_ms);
+    return std::max<size_t>(
+        1, static_cast<size_t>(clamped * 0.001f *
+                                   static_cast<float>(sample_rate_) +
+                               0.5f));
+  }
+
+  // Frameloopen, med konstant kanalantal när N > 0 (se channels.h).
+  // Returnerar minsta gain i blocket.
+  template <int N>
+  float run(float *interleaved, size_t frames, int ch, int channels,
+            float ceiling, float release) noexcept {
+    const int cn = N > 0 ? N : ch;
+    const size_t stride = N > 0 ? N : static_cast<size_t>(channels);
+    const size_t window = lookahead_ + 1;
+    const size_t delay = latency_frames();
+    const size_t detect = tp_on_ ? static_cast<size_t>(tp_delay) : 0;
+    const double inv_len = 1.0 / static_cast<double>(lookahead_);
+    const size_t cap = mask_ + 1;
+
+    float min_gain = 1.0f;
+
+    for (size_t f = 0; f < frames; ++f) {
+      float *frame = interleaved + f * stride;
+
+      if (tp_on_)
+        tp_pos_ = (tp_pos_ + 1) & (tp_taps - 1);
+
+      float peak = 0.0f;
+      for (int c = 0; c < cn; ++c) {
+        const float x = frame[c];
+        peak = std::max(peak, tp_on_ ? true_peak(c, x) : std::fabs(x));
+      }
+
+      const float g_req = peak > ceiling ? ceiling / peak : 1.0f;
+      req_[(n_ + cap - detect) & mask_] = g_req;
+
+      // Glidande minimum över [n - L, n]
+      while (dq_tail_ != dq_head_ && dq_val_[(dq_tail_ - 1) & mask_] >= g_req)
+        --dq_tail_;
+      dq_idx_[dq_tail_ & mask_] = n_;
+      dq_val_[dq_tail_ & mask_] = g_req;
+      ++dq_tail_;
+      while (dq_idx_[dq_head_ & mask_] + window <= n_)
+        ++dq_head_;
+      const float g_min = dq_val_[dq_head_ & mask_];
+
+      // Boxfilter över L värden
+      box_sum_ +=
+          static_cast<double>(g_min) - static_cast<double>(box_[box_pos_]);
+      box_[box_pos_] = g_min;
+      if (++box_pos_ == lookahead_)
+        box_pos_ = 0;
+      const float g_box = static_cast<float>(box_sum_ * inv_len);
+
+      if (g_box < env_)
+        env_ = g_box;
+      else
+        env_ = g_box + release * (env_ - g_box);
+
+      // Boxen ligger redan under gain som samplet som lämnar fördröjningen
+      // kräver; min() med just det värdet gör taket exakt även med
+      // avrundning i boxsumman, utan att hoppa före toppen.
+      const size_t w = n_ & mask_;
+      const size_t r = (n_ + cap - delay) & mask_;
+      const float g = std::min(env_, req_[r]);
+      min_gain = std::min(min_gain, g);
+
+      if (xfade_left_ == 0) {
+        for (int c = 0; c < cn; ++c) {
+          float *line = &delay_[static_cast<size_t>(c) * cap];
+          line[w] = frame[c];
+          frame[c] = line[r] * g;
+        }
+      } else {
+        // efter retune: den gamla läspositionen med sin egen gain, båda
+        // under taket, tonas ut linjärt
+        const size_t r_old = (n_ + cap - xfade_delay_) & mask_;
+        const float g_old = std::min(env_, req_[r_old]);
+        const float a = static_cast<float>(xfade_left_) /
+                        static_cast<float>(xfade_len_ + 1);
+        min_gain = std::min(min_gain, g_old);
+        for (int c = 0; c < cn; ++c) {
+          float *line = &delay_[static_cast<size_t>(c) * cap];
+          line[w] = frame[c];
+          const float y = line[r] * g;
+          frame[c] = y + a * (line[r_old] * g_old - y);
+        }
+        --xfade_left_;
+      }
+
+      ++n_;
+    }
+
+    return min_gain;
+  }
+
+  void reset(size_t lookahead, bool tp) noexcept {
+    lookahead_ = lookahead;
+    tp_on_ = tp;
+    std::fill(delay_.begin(), delay_.end(), 0.0f);
+    std::fill(box_.begin(), box_.end(), 1.0f);
+    std::fill(req_.begin(), req_.end(), 1.0f);
+    std::fill(tp_hist_.begin(), tp_hist_.end(), 0.0f);
+    box_sum_ = static_cast<double>(lookahead_);
+    box_pos_ = 0;
+    dq_head_ = dq_tail_ = 0;
+    tp_pos_ = 0;
+    n_ = 0;
+    env_ = 1.0f;
+    xfade_left_ = 0;
+  }
+
+  // Nytt fönster och/eller true peak i ljudtråden. req_ är indexerad per
+  // insample, så den gäller oavsett läge; det som saknas fylls i från
+  // fördröjningen, där allt indata ligger kvar.
+  void retune(size_t lookahead, bool tp, float ceiling) noexcept {
+    const size_t cap = mask_ + 1;
+    const size_t old_delay = latency_frames();
+    const size_t old_detect = tp_on_ ? static_cast<size_t>(tp_delay) : 0;
+    const size_t detect = tp ? static_cast<size_t>(tp_delay) : 0;
+
+    // true peak av: de senaste samplen hann inte mätas, ta deras toppvärde
+    for (size_t k = detect + 1; k <= old_detect; ++k) {
+      const size_t i = (n_ + cap - k) & mask_;
+      float peak = 0.0f;
+      for (int c = 0; c < max_channels_; ++c)
+        peak = std::max(
+            peak, std::fabs(delay_[static_cast<size_t>(c) * cap + i]));
+      req_[i] = peak > ceiling ? ceiling / peak : 1.0f;
+    }
+    // true peak på: filtrets historik är de senaste insamplen (se true_peak)
+    if (tp && !tp_on_) {
+      for (int c = 0; c < max_channels_; ++c) {
+        const float *line = &delay_[static_cast<size_t>(c) * cap];
+        float *hist = &tp_hist_[static_cast<size_t>(c) * 2 * tp_taps];
+        for (size_t k = 0; k < static_cast<size_t>(tp_taps); ++k) {
+          const size_t p = (tp_pos_ + tp_taps - k) & (tp_taps - 1);
+          hist[p] = hist[p + tp_taps] = line[(n_ + cap - 1 - k) & mask_];
+        }
+      }
+    }
+
+    lookahead_ = lookahead;
+    tp_on_ = tp;
+
+    // Kön och boxen som om det nya fönstret hade gällt hela tiden: boxen
+    // tar minimum för de L senaste framen, som vart och ett täcker L + 1
+    const size_t window = lookahead_ + 1;
+    const size_t from = n_ >= 2 * lookahead_ ? n_ - 2 * lookahead_ : 0;
+    dq_head_ = dq_tail_ = 0;
+    box_sum_ = 0.0;
+    box_pos_ = 0;
+    // i början saknas frames; de räknas som ingen reduktion och är äldst
+    while (box_pos_ + std::min(n_, lookahead_) < lookahead_) {
+      box_[box_pos_++] = 1.0f;
+      box_sum_ += 1.0;
+    }
+    for (size_t j = from; j < n_; ++j) {
+      const float g_req = req_[(j + cap - detect) & mask_];
+      while (dq_tail_ != dq_head_ && dq_val_[(dq_tail_ - 1) & mask_] >= g_req)
+        --dq_tail_;
+      dq_idx_[dq_tail_ & mask_] = j;
+      dq_val_[dq_tail_ & mask_] = g_req;
+      ++dq_tail_;
+      while (dq_idx_[dq_head_ & mask_] + window <= j)
+        ++dq_head_;
+      if (j + lookahead_ >= n_) {
+        box_[box_pos_++] = dq_val_[dq_head_ & mask_];
+        box_sum_ += static_cast<double>(box_[box_pos_ - 1]);
+      }
+    }
+    box_pos_ = 0;
+
+    xfade_delay_ = old_delay;
+    xfade_len_ = xfade_left_ = lookahead_;
+  }
+
+  // Windowed sinc. Fas p interpolerar vid t = n - tp_delay + p/4.
+  void design_true_peak_filter() {
+    for (int p = 1; p < tp_phases; ++p) {
+      const double frac = static_cast<double>(p) / tp_phases;
+      double sum = 0.0;
+      double h[tp_taps];
+      for (int j = 0; j < tp_taps; ++j) {
+        const double t = static_cast<double>(tp_delay - j) - frac;
+        const double sinc =
+            t == 0.0 ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+        const double win =
+            0.5 + 0.5 * std::cos(M_PI * t / static_cast<double>(tp_delay));
+        h[j] = sinc * win;
+        sum += h[j];
+      }
+      // Omvänd ordning: koefficient k multipliceras med n - (tp_taps-1-k)
+      for (int j = 0; j < tp_taps; ++j)
+        tp_coef_[p - 1][tp_taps - 1 - j] = static_cast<float>(h[j] / sum);
+    }
+  }
+
+  // Toppvärde för intervallet [n - tp_delay, n - tp_delay + 1). tp_pos_
+  // stegas en gång per frame av process(). Historiken skrivs dubbelt så att
+  // de senaste tp_taps samplen alltid ligger sammanhängande i minnet.
+  float true_peak(int c, float x) noexcept {
+    float *hist = &tp_hist_[static_cast<size_t>(c) * 2 * tp_taps];
+    hist[tp_pos_] = x;
+    hist[tp_pos_ + tp_taps] = x;
+
+    const float *win = hist + tp_pos_ + 1; // äldst först
+    float peak = std::fabs(win[tp_taps - 1 - tp_delay]);
+    for (int p = 0; p < tp_phases - 1; ++p) {
+      float y = 0.0f;
+      for (int k = 0; k < tp_taps; ++k)
+        y += tp_coef_[p][k] * win[k];
+      peak = std::max(peak, std::fabs(y));
+    }
+    return peak;
+  }
+
+  int sample_rate_{44100};
+  int max_channels_{2};
+
+  size_t mask_{0};
+  size_t lookahead_{1};
+  bool tp_on_{true};
+
+  std::vector<float> delay_;
+
+  std::vector<float> box_;
+  double box_sum_{0.0};
+  size_t box_pos_{0};
+
+  // Nödvändig gain per frame, för samplet som lämnar fördröjningen
+  std::vector<float> req_;
+
+  std::vector<size_t> dq_idx_;
+  std::vector<float> dq_val_;
+  size_t dq_head_{0};
+  size_t dq_tail_{0};
+
+  std::vector<float> tp_hist_;
+  size_t tp_pos_{0};
+  float tp_coef_[tp_phases - 1][tp_taps]{};
+
+  size_t n_{0};
+  float env_{1.0f};
+
+  // övertoning från läspositionen före retune
+  size_t xfade_delay_{0};
+  size_t xfade_len_{0};
+  size_t xfade_left_{0};
+
+  std::atomic<float> ceiling_db_{-1.0f};
+  std::atomic<float> lookahead_ms_{2.0f};
+  std::atomic<float> release_ms_{80.0f};
+  std::atomic<bool> true_peak_{true};
+  std::atomic<float> gain_reduction_db_{0.0f};
+};
+
+} // namespace dsp
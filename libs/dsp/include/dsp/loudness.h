@@ -0,0 +1,337 @@
+#pragma once
+
+#include "dsp/channels.h"
+#include "dsp/effect.h"
+#include "dsp/silence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp {
+
+// Loudnessmätning enligt EBU R128 / ITU-R BS.1770 och en långsam makeup
+// gain mot en mållevel.
+//
+// Signalen K-vägs (högfrekvenshylla + högpass) och energin summeras i block
+// om 100 ms. Momentary (400 ms) och short-term (3 s) är löpande summor över
+// de senaste 4 resp. 30 blocken. Integrated grindas absolut (-70 LUFS) och
+// relativt (-10 LU under grindat medel): varje 400 ms-block läggs i ett
+// histogram med 0,1 dB-fack, och summan över facken ovanför den relativa
+// grinden hålls uppdaterad genom att grinden flyttas fack för fack när
+// medlet ändras. Inget block i historiken läses om.
+//
+// Mätningen görs före gain, så att regleringen inte mäter sig själv.
+class loudness final : public effect {
+public:
+  static constexpr float min_lufs = -120.0f; // tyst
+  static constexpr float max_gain_db = 12.0f;
+
+  explicit loudness(int sample_rate = 44100, int max_channels = 2) {
+    prepare(sample_rate, max_channels, 0);
+  }
+
+  void prepare(int sample_rate, int max_channels, size_t) override {
+    sample_rate_ = std::max(1, sample_rate);
+    max_channels_ = std::max(1, max_channels);
+    design_k_weighting();
+
+    // 5.1 (L R C LFE Ls Rs): LFE räknas inte, surround +1,5 dB
+    weight_.assign(static_cast<size_t>(max_channels_), 1.0);
+    if (max_channels_ == 6) {
+      weight_[3] = 0.0;
+      weight_[4] = weight_[5] = 1.41;
+    }
+
+    z_.assign(static_cast<size_t>(max_channels_) * 4, 0.0);
+    block_frames_ = static_cast<size_t>(std::max(1, sample_rate_ / 10));
+    gain_coef_ = static_cast<float>(
+        1.0 - std::exp(-1.0 / (gain_smoothing_s * sample_rate_)));
+    reset();
+  }
+
+  // LUFS, clampas till [-36, -6]
+  void set_target_lufs(float lufs) noexcept {
+    target_lufs_.store(std::clamp(lufs, -36.0f, -6.0f),
+                       std::memory_order_relaxed);
+  }
+  void set_normalize(bool on) noexcept {
+    normalize_.store(on, std::memory_order_relaxed);
+  }
+
+  // Börjar om integreringen (ny låt). Nuvarande gain hålls tills det nya
+  // medlet är pålitligt.
+  void reset_integration() noexcept {
+    std::fill(std::begin(bin_count_), std::end(bin_count_), 0u);
+    std::fill(std::begin(bin_sum_), std::end(bin_sum_), 0.0);
+    gated_count_ = above_count_ = 0;
+    gated_sum_ = above_sum_ = 0.0;
+    gate_bin_ = 0;
+    integrated_lufs_.store(min_lufs, std::memory_order_relaxed);
+  }
+
+  // Mätvärden, skrivs av ljudtråden var 100:e ms
+  float momentary_lufs() const noexcept {
+    return momentary_lufs_.load(std::memory_order_relaxed);
+  }
+  float short_term_lufs() const noexcept {
+    return short_term_lufs_.load(std::memory_order_relaxed);
+  }
+  float integrated_lufs() const noexcept {
+    return integrated_lufs_.load(std::memory_order_relaxed);
+  }
+  // Aktuell makeup gain
+  float gain_db() const noexcept {
+    return gain_db_.load(std::memory_order_relaxed);
+  }
+
+  const char *name() const noexcept override { return "loudness"; }
+
+  // Filterminnet är tyst och gain ligger på målet; ingen mätning sker på
+  // tystnad ändå (under absoluta grinden).
+  bool tail_decayed() const noexcept override {
+    for (double z : z_) {
+      if (std::fabs(z) >= static_cast<double>(silence_threshold))
+        return false;
+    }
+    return std::fabs(gain_ - gain_target_) < 1e-4f;
+  }
+
+  void process(float *interleaved, size_t frames,
+               int channels) noexcept override {
+    if (!interleaved || frames == 0 || channels <= 0)
+      return;
+
+    const int ch = std::min(channels, max_channels_);
+    dispatch_channels(ch, channels, [&](auto n) {
+      run<decltype(n)::value>(interleaved, frames, ch, channels);
+    });
+
+    gain_db_.store(20.0f * std::log10(std::max(gain_, 1e-6f)),
+                   std::memory_order_relaxed);
+  }
+
+  // Tysta frames när tail_decayed(): samma mätning som process() på nollor
+  // men utan filtren, så att momentary och short-term faller under tystnad.
+  // Integrated påverkas inte (under absoluta grinden).
+  void process_silence(size_t frames) noexcept {
+    while (frames > 0) {
+      const size_t n = std::min(frames, block_frames_ - acc_frames_);
+      acc_frames_ += n;
+      frames -= n;
+      if (acc_frames_ == block_frames_)
+        end_block();
+    }
+  }
+
+private:
+  static constexpr int short_blocks = 30; // 3 s
+  static constexpr int momentary_blocks = 4; // 400 ms
+  static constexpr float abs_gate_lufs = -70.0f;
+  static constexpr float max_lufs = 5.0f;
+  static constexpr int bins_per_db = 10;
+  static constexpr int bins =
+      static_cast<int>(max_lufs - abs_gate_lufs) * bins_per_db;
+  // så många grindade block (à 100 ms steg) innan gain följer en ny låt
+  static constexpr uint32_t min_gated_blocks = 20;
+  static constexpr double gain_smoothing_s = 3.0;
+
+  static float to_lufs(double energy) noexcept {
+    if (energy <= 0.0)
+      return min_lufs;
+    return std::max(min_lufs,
+                    static_cast<float>(-0.691 + 10.0 * std::log10(energy)));
+  }
+
+  static int to_bin(float lufs) noexcept {
+    const int b = static_cast<int>(
+        std::floor((lufs - abs_gate_lufs) * static_cast<float>(bins_per_db)));
+    return std::clamp(b, 0, bins - 1);
+  }
+
+  template <int N>
+  void run(float *interleaved, size_t frames, int ch, int channels) noexcept {
+    const int cn = N > 0 ? N : ch;
+    const size_t stride = N > 0 ? N : static_cast<size_t>(channels);
+
+    for (size_t f = 0; f < frames; ++f) {
+      float *frame = interleaved + f * stride;
+
+      double e = 0.0;
+      for (int c = 0; c < cn; ++c) {
+        double *z = &z_[static_cast<size_t>(c) * 4];
+        // hylla och högpass, transponerad direktform II
+        const double x = frame[c];
+        const double y1 = shelf_b_[0] * x + z[0];
+        z[0] = shelf_b_[1] * x - shelf_a_[0] * y1 + z[1];
+        z[1] = shelf_b_[2] * x - shelf_a_[1] * y1;
+        const double y2 = y1 + z[2]; // b = 1, -2, 1
+        z[2] = -2.0 * y1 - hp_a_[0] * y2 + z[3];
+        z[3] = y1 - hp_a_[1] * y2;
+        e += weight_[static_cast<size_t>(c)] * y2 * y2;
+      }
+      acc_ += e;
+      if (++acc_frames_ == block_frames_)
+        end_block();
+
+      gain_ += gain_coef_ * (gain_target_ - gain_);
+      for (int c = 0; c < cn; ++c)
+        frame[c] *= gain_;
+    }
+  }
+
+  void end_block() noexcept {
+    const double block = acc_ / static_cast<double>(block_frames_);
+    acc_ = 0.0;
+    acc_frames_ = 0;
+
+    // Löpande summor; den som lämnar fönstret dras av
+    const int pos = block_pos_;
+    short_sum_ += block - blocks_[pos];
+    momentary_sum_ +=
+        block - blocks_[(pos + short_blocks - momentary_blocks) % short_blocks];
+    blocks_[pos] = block;
+    block_pos_ = (pos + 1) % short_blocks;
+
+    const double momentary = std::max(0.0, momentary_sum_ / momentary_blocks);
+    const double short_term = std::max(0.0, short_sum_ / short_blocks);
+    momentary_lufs_.store(to_lufs(momentary), std::memory_order_relaxed);
+    short_term_lufs_.store(to_lufs(short_term), std::memory_order_relaxed);
+
+    // 400 ms-blocken överlappar 75 %, dvs. ett nytt var 100:e ms
+    if (++blocks_seen_ >= momentary_blocks)
+      add_gating_block(momentary);
+
+    if (!normalize_.load(std::memory_order_relaxed)) {
+      gain_target_ = 1.0f;
+    } else if (above_count_ >= min_gated_blocks) {
+      const float db =
+          std::clamp(target_lufs_.load(std::memory_order_relaxed) -
+                         integrated_lufs_.load(std::memory_order_relaxed),
+                     -max_gain_db, max_gain_db);
+      gain_target_ = std::pow(10.0f, db / 20.0f);
+    }
+  }
+
+  void add_gating_block(double energy) noexcept {
+    const float l = to_lufs(energy);
+    if (l < abs_gate_lufs)
+      return;
+
+    const int b = to_bin(l);
+    bin_count_[b]++;
+    bin_sum_[b] += energy;
+    gated_count_++;
+    gated_sum_ += energy;
+    if (b >= gate_bin_) {
+      above_count_++;
+      above_sum_ += energy;
+    }
+
+    // Relativa grinden rör sig lite per block; flytta fack för fack
+    const int gate =
+        to_bin(to_lufs(gated_sum_ / static_cast<double>(gated_count_)) -
+               10.0f);
+    while (gate_bin_ < gate) {
+      above_count_ -= bin_count_[gate_bin_];
+      above_sum_ -= bin_sum_[gate_bin_];
+      gate_bin_++;
+    }
+    while (gate_bin_ > gate) {
+      gate_bin_--;
+      above_count_ += bin_count_[gate_bin_];
+      above_sum_ += bin_sum_[gate_bin_];
+    }
+
+    if (above_count_ > 0) {
+      integrated_lufs_.store(
+          to_lufs(above_sum_ / static_cast<double>(above_count_)),
+          std::memory_order_relaxed);
+    }
+  }
+
+  void reset() noexcept {
+    std::fill(z_.begin(), z_.end(), 0.0);
+    std::fill(std::begin(blocks_), std::end(blocks_), 0.0);
+    short_sum_ = momentary_sum_ = 0.0;
+    block_pos_ = 0;
+    blocks_seen_ = 0;
+    acc_ = 0.0;
+    acc_frames_ = 0;
+    gain_ = gain_target_ = 1.0f;
+    momentary_lufs_.store(min_lufs, std::memory_order_relaxed);
+    short_term_lufs_.store(min_lufs, std::memory_order_relaxed);
+    reset_integration();
+  }
+
+  // BS.1770, samma konstruktion som libebur128 så att filtren stämmer för
+  // alla samplerates, inte bara 48 kHz
+  void design_k_weighting() {
+    const double fs = static_cast<double>(sample_rate_);
+    {
+      const double f0 = 1681.974450955533;
+      const double g = 3.999843853973347;
+      const double q = 0.7071752369554196;
+      const double k = std::tan(M_PI * f0 / fs);
+      const double vh = std::pow(10.0, g / 20.0);
+      const double vb = std::pow(vh, 0.4996667741545416);
+      const double a0 = 1.0 + k / q + k * k;
+      shelf_b_[0] = (vh + vb * k / q + k * k) / a0;
+      shelf_b_[1] = 2.0 * (k * k - vh) / a0;
+      shelf_b_[2] = (vh - vb * k / q + k * k) / a0;
+      shelf_a_[0] = 2.0 * (k * k - 1.0) / a0;
+      shelf_a_[1] = (1.0 - k / q + k * k) / a0;
+    }
+    {
+      const double f0 = 38.13547087602444;
+      const double q = 0.5003270373238773;
+      const double k = std::tan(M_PI * f0 / fs);
+      const double a0 = 1.0 + k / q + k * k;
+      hp_a_[0] = 2.0 * (k * k - 1.0) / a0;
+      hp_a_[1] = (1.0 - k / q + k * k) / a0;
+    }
+  }
+
+  int sample_rate_{44100};
+  int max_channels_{2};
+
+  double shelf_b_[3]{};
+  double shelf_a_[2]{};
+  double hp_a_[2]{};
+  std::vector<double> weight_;
+  std::vector<double> z_; // 4 per kanal
+
+  size_t block_frames_{4410};
+  double acc_{0.0};
+  size_t acc_frames_{0};
+
+  double blocks_[short_blocks]{};
+  int block_pos_{0};
+  uint64_t blocks_seen_{0};
+  double short_sum_{0.0};
+  double momentary_sum_{0.0};
+
+  uint32_t bin_count_[bins]{};
+  double bin_sum_[bins]{};
+  uint32_t gated_count_{0};
+  double gated_sum_{0.0};
+  int gate_bin_{0};
+  uint32_t above_count_{0};
+  double above_sum_{0.0};
+
+  float gain_{1.0f};
+  float gain_target_{1.0f};
+  float gain_coef_{0.0f};
+
+  std::atomic<float> target_lufs_{-18.0f};
+  std::atomic<bool> normalize_{false};
+  std::atomic<float> momentary_lufs_{min_lufs};
+  std::atomic<float> short_term_lufs_{min_lufs};
+  std::atomic<float> integrated_lufs_{min_lufs};
+  std::atomic<float> gain_db_{0.0f};
+};
+
+} // namespace dsp
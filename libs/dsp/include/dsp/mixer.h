@@ -0,0 +1,199 @@
+#pragma once
+
+#include "dsp/silence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp {
+
+// Mixer före EffectChain för flera ingångar (Spotify, ringklocka, line-in).
+//
+// Varje plats har gain och prioritet. En ingång som låter sänker (duckar)
+// alla ingångar med lägre prioritet med sitt duck_db. Ducknivån jämnas ut
+// per block i dB-domänen (snabb attack, långsam release) och gain rampas
+// linjärt över blocket, så att inga steg hörs.
+//
+// Mixningen sker planärt: varje ingång delas upp per kanal och läggs på
+// summan med en multiply-accumulate mot gainrampen, en ren SIMD-loop per
+// kanal. Summan interleavas tillbaka i slutet.
+class mixer {
+public:
+  static constexpr int max_inputs = 8;
+
+  struct input {
+    const float *interleaved = nullptr; // nullptr => tom plats
+    size_t frames = 0;                  // levererade frames, resten tyst
+    float gain_db = 0.0f;
+    int priority = 0;
+    float duck_db = -18.0f; // sänkning av lägre prioriteter när denna låter
+    bool restart = false;   // ny källa i platsen: nollställ envelopes
+  };
+
+  explicit mixer(int sample_rate = 44100, int channels = 2,
+                 size_t max_block = 1024) {
+    prepare(sample_rate, channels, max_block);
+  }
+
+  void prepare(int sample_rate, int channels, size_t max_block) {
+    sample_rate_ = static_cast<float>(std::max(1, sample_rate));
+    channels_ = std::max(1, channels);
+    max_block_ = std::max<size_t>(1, max_block);
+
+    planar_.assign(static_cast<size_t>(channels_) * max_block_, 0.0f);
+    acc_.assign(static_cast<size_t>(channels_) * max_block_, 0.0f);
+    ramp_.assign(max_block_, 0.0f);
+
+    for (slot &s : slots_)
+      s = slot{};
+  }
+
+  // inputs har max_inputs element. out rymmer frames * channels samples.
+  // frames <= max_block.
+  void process(const input *inputs, float *out, size_t frames) noexcept {
+    frames = std::min(frames, max_block_);
+    const size_t ch = static_cast<size_t>(channels_);
+    const float block_s = static_cast<float>(frames) / sample_rate_;
+    const size_t hold = static_cast<size_t>(hold_s * sample_rate_);
+    const float attack = std::exp(-block_s / attack_s);
+    const float release = std::exp(-block_s / release_s);
+
+    // 1. Vilka ingångar låter just nu (med hold över korta pauser)
+    bool sounding[max_inputs];
+    for (int i = 0; i < max_inputs; ++i) {
+      const input &in = inputs[i];
+      slot &s = slots_[i];
+      if (!in.interleaved || in.restart)
+        s = slot{};
+      if (!in.interleaved) {
+        sounding[i] = false;
+        continue;
+      }
+
+      const uint32_t peak = max_abs_bits(in.interleaved, in.frames * ch);
+      const float peak_lin = std::bit_cast<float>(peak);
+      s.level_db = 20.0f * std::log10(std::max(peak_lin, 1e-6f));
+      if (peak >= std::bit_cast<uint32_t>(activity_threshold))
+        s.hold_left = hold;
+      else
+        s.hold_left -= std::min(s.hold_left, frames);
+      sounding[i] = s.hold_left > 0;
+    }
+
+    // 2. Ducknivå per ingång från sounding ingångar med högre prioritet
+    for (int i = 0; i < max_inputs; ++i) {
+      if (!inputs[i].interleaved)
+        continue;
+      float target = 0.0f;
+      for (int j = 0; j < max_inputs; ++j) {
+        if (j != i && sounding[j] && inputs[j].priority > inputs[i].priority)
+          target = std::min(target, std::min(inputs[j].duck_db, 0.0f));
+      }
+
+      slot &s = slots_[i];
+      const float coef = target < s.duck_db ? attack : release;
+      s.duck_db = target + coef * (s.duck_db - target);
+    }
+
+    // 3. Planär multiply-accumulate
+    std::fill(acc_.begin(),
+              acc_.begin() + static_cast<std::ptrdiff_t>(ch * frames), 0.0f);
+
+    for (int i = 0; i < max_inputs; ++i) {
+      const input &in = inputs[i];
+      if (!in.interleaved)
+        continue;
+      slot &s = slots_[i];
+
+      const float g1 =
+          std::pow(10.0f, (in.gain_db + s.duck_db) / 20.0f);
+      const float g0 = s.started ? s.gain : g1;
+      s.gain = g1;
+      s.started = true;
+
+      const size_t n = std::min(in.frames, frames);
+      if (n == 0 || (g0 == 0.0f && g1 == 0.0f))
+        continue;
+
+      const float step = (g1 - g0) / static_cast<float>(frames);
+      for (size_t f = 0; f < n; ++f)
+        ramp_[f] = g0 + step * static_cast<float>(f + 1);
+
+      deinterleave(in.interleaved, n);
+      for (size_t c = 0; c < ch; ++c) {
+        const float *x = &planar_[c * max_block_];
+        float *acc = &acc_[c * frames];
+        for (size_t f = 0; f < n; ++f)
+          acc[f] += x[f] * ramp_[f];
+      }
+    }
+
+    // 4. Tillbaka till interleavat
+    for (size_t c = 0; c < ch; ++c) {
+      const float *acc = &acc_[c * frames];
+      for (size_t f = 0; f < frames; ++f)
+        out[f * ch + c] = acc[f];
+    }
+
+    for (int i = 0; i < max_inputs; ++i) {
+      level_db_[i].store(inputs[i].interleaved ? slots_[i].level_db : -120.0f,
+                         std::memory_order_relaxed);
+      duck_db_[i].store(slots_[i].duck_db, std::memory_order_relaxed);
+    }
+  }
+
+  // Mätvärden från senaste blocket, för kontroll-API:t.
+  float level_db(int slot) const noexcept {
+    if (slot < 0 || slot >= max_inputs)
+      return -120.0f;
+    return level_db_[slot].load(std::memory_order_relaxed);
+  }
+  float duck_db(int slot) const noexcept {
+    if (slot < 0 || slot >= max_inputs)
+      return 0.0f;
+    return duck_db_[slot].load(std::memory_order_relaxed);
+  }
+
+private:
+  // över -50 dBFS räknas ingången som ljudande
+  static constexpr float activity_threshold = 0.00316f;
+  static constexpr float hold_s = 0.3f;
+  static constexpr float attack_s = 0.05f;
+  static constexpr float release_s = 0.6f;
+
+  struct slot {
+    float gain = 1.0f;
+    bool started = false;
+    float duck_db = 0.0f;
+    size_t hold_left = 0;
+    float level_db = -120.0f;
+  };
+
+  void deinterleave(const float *in, size_t frames) noexcept {
+    const size_t ch = static_cast<size_t>(channels_);
+    for (size_t c = 0; c < ch; ++c) {
+      float *x = &planar_[c * max_block_];
+      for (size_t f = 0; f < frames; ++f)
+        x[f] = in[f * ch + c];
+    }
+  }
+
+  float sample_rate_{44100.0f};
+  int channels_{2};
+  size_t max_block_{1024};
+
+  std::vector<float> planar_;
+  std::vector<float> acc_;
+  std::vector<float> ramp_;
+
+  slot slots_[max_inputs]{};
+  std::atomic<float> level_db_[max_inputs]{};
+  std::atomic<float> duck_db_[max_inputs]{};
+};
+
+} // namespace dsp
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "dsp/crossover.h"
+#include "dsp/effect.h"
+#include "dsp/fast_math.h"
+#include "dsp/silence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace dsp {
+
+// Flerbands kompressor/expander.
+//
+// Signalen delas med crossover (LR4, summerar plant) i 3-4 band. Varje
+// band x kanal är en bana. Per sample körs bara en linjär toppföljare per
+// bana (abs, max, mul). Var control_frames:e frame tas nivån till log2-
+// domänen med fast_log2, gain-kurvan räknas i dB, jämnas ut med attack/
+// release och går tillbaka till linjär gain med fast_exp2; gain rampas
+// linjärt över nästa delblock. Inga std::pow/std::log10 i ljudtråden.
+//
+// Banorna ligger i fasta arrayer med bredden lane_width så att looparna
+// blir grenlösa och vektoriseras. Kanalerna inom ett band länkas (minsta
+// gain) så att stereobilden står still.
+class multiband_dynamics final : public effect {
+public:
+  static constexpr int max_bands = crossover::max_ways;
+  // banorna ligger i fasta arrayer, så dynamiken hanterar högst 8 kanaler
+  static constexpr int max_supported_channels = 8;
+
+  multiband_dynamics(float sample_rate, int max_channels = 2,
+                     const std::vector<float> &split_hz = {200.0f, 2500.0f})
+      : split_hz_(split_hz) {
+    // Extra lane_width i slutet: banloopen läser alltid hela grupper, även
+    // förbi sista raden. De överskjutande banorna används aldrig.
+    scratch_.assign(chunk_frames * max_lanes + lane_width, 0.0f);
+
+    for (int b = 0; b < max_bands; ++b) {
+      band &p = bands_param_[b];
+      p.threshold_db = -18.0f;
+      p.ratio = 3.0f;
+      p.expander_threshold_db = -60.0f;
+      p.expander_ratio = 1.0f; // av tills set_expander()
+      p.makeup_db = 0.0f;
+      p.attack_ms = 10.0f;
+      p.release_ms = 150.0f;
+    }
+    // basen får längre tider för att inte modulera vågformen
+    bands_param_[0].attack_ms = 30.0f;
+    bands_param_[0].release_ms = 300.0f;
+
+    prepare(static_cast<int>(sample_rate), max_channels, 0);
+  }
+
+  void prepare(int sample_rate, int max_channels, size_t) override {
+    sample_rate_ = static_cast<float>(std::max(1, sample_rate));
+    max_channels_ = std::clamp(max_channels, 1, max_supported_channels);
+
+    split_ = crossover(sample_rate_, max_channels_, 4);
+    split_.set_frequencies(split_hz_);
+    bands_ = split_.ways();
+
+    // toppföljarens release, fast och kort: tiderna sitter i gain-steget
+    env_release_ = std::exp(-1.0f / (0.005f * sample_rate_));
+    for (int b = 0; b < max_bands; ++b)
+      set_times(b, bands_param_[b].attack_ms, bands_param_[b].release_ms);
+
+    lane_channels_ = 0; // nollställer följarna vid nästa process()
+  }
+
+  int bands() const noexcept { return bands_; }
+
+  // Sätts från samma tråd som process(), som eq3band.
+  void set_threshold_db(int b, float db) {
+    if (b < 0 || b >= max_bands)
+      return;
+    bands_param_[b].threshold_db = std::clamp(db, -60.0f, 0.0f);
+  }
+
+  void set_ratio(int b, float ratio) {
+    if (b < 0 || b >= max_bands)
+      return;
+    bands_param_[b].ratio = std::clamp(ratio, 1.0f, 20.0f);
+  }
+
+  void set_expander(int b, float threshold_db, float ratio) {
+    if (b < 0 || b >= max_bands)
+      return;
+    bands_param_[b].expander_threshold_db =
+        std::clamp(threshold_db, -90.0f, 0.0f);
+    bands_param_[b].expander_ratio = std::clamp(ratio, 1.0f, 10.0f);
+  }
+
+  void set_makeup_db(int b, float db) {
+    if (b < 0 || b >= max_bands)
+      return;
+    bands_param_[b].makeup_db = std::clamp(db, -12.0f, 24.0f);
+  }
+
+  void set_times(int b, float attack_ms, float release_ms) {
+    if (b < 0 || b >= max_bands)
+      return;
+    band &p = bands_param_[b];
+    p.attack_ms = std::clamp(attack_ms, 0.1f, 500.0f);
+    p.release_ms = std::clamp(release_ms, 1.0f, 5000.0f);
+    p.attack = time_coef(p.attack_ms);
+    p.release = time_coef(p.release_ms);
+  }
+
+  // Gain-reduktion per band i senaste blocket (>= 0 dB).
+  float gain_reduction_db(int b) const noexcept {
+    if (b < 0 || b >= max_bands)
+      return 0.0f;
+    return gain_reduction_db_[b].load(std::memory_order_relaxed);
+  }
+
+  // Delningsfiltren och följarna är tysta och gain har landat på sitt mål,
+  // så att ett överhoppat block inte ändrar något när signalen kommer åter.
+  bool tail_decayed() const noexcept override {
+    if (!split_.tail_decayed() || !is_silent(env_, max_lanes))
+      return false;
+    for (size_t l = 0; l < max_lanes; ++l) {
+      if (std::fabs(gain_db_[l] - target_db_[l]) > 0.01f)
+        return false;
+    }
+    return true;
+  }
+
+  const char *name() const noexcept override { return "multiband_dynamics"; }
+
+  void process(float *interleaved, size_t frames,
+               int channels) noexcept override {
+    if (!interleaved || frames == 0 || channels <= 0)
+      return;
+
+    const int ch = std::min(channels, max_channels_);
+    const size_t lanes = static_cast<size_t>(bands_) * static_cast<size_t>(ch);
+    if (ch != lane_channels_) {
+      lane_channels_ = ch;
+      std::fill(std::begin(env_), std::end(env_), 0.0f);
+      std::fill(std::begin(gain_db_), std::end(gain_db_), 0.0f);
+      std::fill(std::begin(target_db_), std::end(target_db_), 0.0f);
+      std::fill(std::begin(gain_lin_), std::end(gain_lin_), 1.0f);
+    }
+    update_lanes();
+
+    float max_gr[max_bands]{};
+
+    for (size_t done = 0; done < frames; done += chunk_frames) {
+      const size_t n = std::min(chunk_frames, frames - done);
+      float *io = interleaved + done * static_cast<size_t>(channels);
+
+      split_.process(io, scratch_.data(), n, channels);
+
+      for (size_t f0 = 0; f0 < n; f0 += control_frames) {
+        const size_t m = std::min(control_frames, n - f0);
+
+        // Toppföljare per sample
+        for (size_t f = f0; f < f0 + m; ++f) {
+          const float *row = &scratch_[f * lanes];
+          for (size_t l0 = 0; l0 < lanes; l0 += lane_width) {
+            for (size_t k = 0; k < lane_width; ++k) {
+              const float a = std::fabs(row[l0 + k]);
+              env_[l0 + k] = std::max(a, env_[l0 + k] * env_release_);
+            }
+          }
+        }
+
+        // Gain-kurva i log-domänen, en gång per delblock
+        for (size_t l = 0; l < max_lanes; ++l) {
+          const float level = fast_log2(env_[l] + 1e-9f) * db_per_log2;
+          const float over = std::max(level - lane_threshold_[l], 0.0f);
+          const float under =
+              std::max(lane_expander_threshold_[l] - level, 0.0f);
+          const float target =
+              -over * lane_comp_slope_[l] -
+              std::min(under * lane_exp_slope_[l], max_expansion_db);
+
+          // Attack när gain ska ned, release när den får gå upp. Båda
+          // laddas ovillkorligt så att valet blir en blend, inte en gren.
+          const float att = lane_attack_[l];
+          const float rel = lane_release_[l];
+          const float prev = gain_db_[l];
+          const float coef = target < prev ? att : rel;
+          gain_db_[l] = target + coef * (prev - target);
+          target_db_[l] = target;
+        }
+
+        // Länka kanalerna inom bandet, ramp från föregående gain
+        float from[max_bands];
+        float step[max_bands];
+        for (int b = 0; b < bands_; ++b) {
+          float link = 0.0f;
+          for (int c = 0; c < ch; ++c)
+            link = std::min(link, gain_db_[b * ch + c]);
+          max_gr[b] = std::min(max_gr[b], link);
+
+          const float to = fast_exp2((link + makeup_db_[b]) * log2_per_db);
+          from[b] = gain_lin_[b];
+          step[b] = (to - from[b]) / static_cast<float>(m);
+          gain_lin_[b] = to;
+        }
+
+        for (size_t i = 0; i < m; ++i) {
+          const size_t f = f0 + i;
+          const float *row = &scratch_[f * lanes];
+          float *out = io + f * static_cast<size_t>(channels);
+          for (int c = 0; c < ch; ++c)
+            out[c] = 0.0f;
+          for (int b = 0; b < bands_; ++b) {
+            const float g = from[b] + step[b] * static_cast<float>(i + 1);
+            for (int c = 0; c < ch; ++c)
+              out[c] += row[b * ch + c] * g;
+          }
+        }
+      }
+    }
+
+    for (int b = 0; b < max_bands; ++b)
+      gain_reduction_db_[b].store(-max_gr[b], std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr size_t chunk_frames = 256;
+  static constexpr size_t control_frames = 16;
+  static constexpr size_t lane_width = 8;
+  static constexpr size_t max_lanes =
+      static_cast<size_t>(max_bands * max_supported_channels);
+  static constexpr float log2_per_db = 1.0f / db_per_log2;
+  // expandern dämpar som mest så här mycket, annars går tysta band mot -inf
+  static constexpr float max_expansion_db = 24.0f;
+
+  struct band {
+    float threshold_db;
+    float ratio;
+    float expander_threshold_db;
+    float expander_ratio;
+    float makeup_db;
+    float attack_ms;
+    float release_ms;
+    float attack;
+    float release;
+  };
+
+  // Koefficient per delblock, inte per sample
+  float time_coef(float ms) const {
+    return std::exp(-static_cast<float>(control_frames) /
+                    (0.001f * ms * sample_rate_));
+  }
+
+  // Bredda bandparametrarna till en bana per band x kanal, i samma ordning
+  // som crossover lägger ut vägarna (b * ch + c). Billigt, görs per block.
+  void update_lanes() {
+    const size_t ch = static_cast<size_t>(lane_channels_);
+    for (size_t l = 0; l < max_lanes; ++l) {
+      const band &p =
+          bands_param_[std::min(l / ch, static_cast<size_t>(max_bands - 1))];
+      lane_threshold_[l] = p.threshold_db;
+      lane_expander_threshold_[l] = p.expander_threshold_db;
+      lane_comp_slope_[l] = 1.0f - 1.0f / p.ratio;
+      lane_exp_slope_[l] = p.expander_ratio - 1.0f;
+      lane_attack_[l] = p.attack;
+      lane_release_[l] = p.release;
+    }
+    for (int b = 0; b < max_bands; ++b)
+      makeup_db_[b] = bands_param_[b].makeup_db;
+  }
+
+  std::vector<float> split_hz_;
+  float sample_rate_{44100.0f};
+  int max_channels_{2};
+  crossover split_{44100.0f};
+  int bands_{3};
+  int lane_channels_{0};
+
+  band bands_param_[max_bands]{};
+  float makeup_db_[max_bands]{};
+  float gain_lin_[max_bands]{};
+  float env_release_{0.0f};
+
+  std::vector<float> scratch_;
+
+  alignas(32) float env_[max_lanes + lane_width]{};
+  alignas(32) float gain_db_[max_lanes]{};
+  alignas(32) float target_db_[max_lanes]{};
+  alignas(32) float lane_threshold_[max_lanes]{};
+  alignas(32) float lane_expander_threshold_[max_lanes]{};
+  alignas(32) float lane_comp_slope_[max_lanes]{};
+  alignas(32) float lane_exp_slope_[max_lanes]{};
+  alignas(32) float lane_attack_[max_lanes]{};
+  alignas(32) float lane_release_[max_lanes]{};
+
+  std::atomic<float> gain_reduction_db_[max_bands]{};
+};
+
+} // namespace dsp
@@ -1,11 +1,13 @@
 #pragma once
+#include "channels.h"
+#include "delay_line.h"
 #include "effect.h"
+#include "silence.h"
 
 #include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstddef>
-#include <cstdint>
-#include <vector>
 
 namespace dsp {
 
@@ -13,20 +15,26 @@ class reverb final : public effect {
 public:
   explicit reverb(int sampleRate = 44100, float maxDelayMs = 2000.0f,
                   int maxChannels = 2)
-      : sampleRate_(sampleRate), maxChannels_(std::max(1, maxChannels)) {
-
-    const size_t maxDelaySamples = static_cast<size_t>(
-        (maxDelayMs * 0.001f) * static_cast<float>(sampleRate_));
-    // +1 för att undvika edge-cases vid wrap
-    delayLineLen_ = std::max<size_t>(1, maxDelaySamples + 1);
-
-    delayLines_.resize(static_cast<size_t>(maxChannels_) * delayLineLen_, 0.0f);
-    writeIdx_.assign(static_cast<size_t>(maxChannels_), 0);
-
+      : maxDelayMsConfig_(maxDelayMs) {
     setDelayMs(120.0f);
     setFeedback(0.25f);
     setWet(0.55f);
     setDry(0.8f);
+    prepare(sampleRate, maxChannels, 0);
+  }
+
+  void prepare(int sampleRate, int maxChannels, size_t) override {
+    sampleRate_ = std::max(1, sampleRate);
+    maxChannels_ = std::max(1, maxChannels);
+
+    maxDelaySamples_ = std::max<size_t>(
+        1, static_cast<size_t>((maxDelayMsConfig_ * 0.001f) *
+                               static_cast<float>(sampleRate_)));
+    line_.prepare(maxDelaySamples_, maxChannels_);
+    // Nya fördröjningar glider in över ~30 ms i stället för att hoppa
+    glide_ = 1.0f - std::exp(-1.0f / (0.03f * static_cast<float>(sampleRate_)));
+    delaySet_ = false;
+    quietFrames_ = line_.capacity();
   }
 
   void setDelayMs(float ms) noexcept {
@@ -42,6 +50,8 @@ public:
     dry_.store(dry, std::memory_order_relaxed);
   }
 
+  const char *name() const noexcept override { return "reverb"; }
+
   void process(float *interleaved, size_t frames,
                int channels) noexcept override {
     if (!interleaved || frames == 0 || channels <= 0)
@@ -61,49 +71,82 @@ public:
     wet = std::clamp(wet, 0.0f, 1.0f);
     dry = std::clamp(dry, 0.0f, 2.0f);
 
-    const size_t delaySamples = static_cast<size_t>(
-        (delayMs * 0.001f) * static_cast<float>(sampleRate_));
+    // Minst ett sampel: läsningen sker före skrivningen i samma frame
+    const float target =
+        std::clamp((delayMs * 0.001f) * static_cast<float>(sampleRate_), 1.0f,
+                   static_cast<float>(maxDelaySamples_));
+    if (!delaySet_) {
+      delay_ = target;
+      delaySet_ = true;
+    }
 
-    for (size_t f = 0; f < frames; ++f) {
-      const size_t base = f * static_cast<size_t>(channels);
+    float peak = 0.0f;
+    dispatch_channels(ch, channels, [&](auto n) {
+      peak = run<decltype(n)::value>(interleaved, frames, ch, channels,
+                                     target, fb, wet, dry);
+    });
+
+    // Svansen är borta när hela linjen har skrivits över med tyst signal
+    if (peak < silence_threshold)
+      quietFrames_ = std::min(quietFrames_ + frames, line_.capacity());
+    else
+      quietFrames_ = 0;
+  }
 
-      for (int c = 0; c < ch; ++c) {
-        float x = interleaved[base + static_cast<size_t>(c)];
+  bool tail_decayed() const noexcept override {
+    return quietFrames_ >= line_.capacity();
+  }
+
+  float maxDelayMs() const noexcept {
+    return (static_cast<float>(maxDelaySamples_) /
+            static_cast<float>(sampleRate_)) *
+           1000.0f;
+  }
 
-        size_t &w = writeIdx_[static_cast<size_t>(c)];
-        // Läsposition = w - delaySamples (wrap)
-        size_t r = (w + delayLineLen_ - (delaySamples % delayLineLen_)) %
-                   delayLineLen_;
+private:
+  // Frameloopen, med konstant kanalantal när N > 0 (se channels.h).
+  // Returnerar största värdet som skrevs in i linjerna.
+  template <int N>
+  float run(float *interleaved, size_t frames, int ch, int channels,
+            float target, float fb, float wet, float dry) noexcept {
+    const int cn = N > 0 ? N : ch;
+    const size_t stride = N > 0 ? N : static_cast<size_t>(channels);
+    float peak = 0.0f;
+    float delay = delay_;
 
-        float *line = &delayLines_[static_cast<size_t>(c) * delayLineLen_];
+    for (size_t f = 0; f < frames; ++f) {
+      const size_t base = f * stride;
+      delay += glide_ * (target - delay);
 
-        float delayed = line[r];
+      for (int c = 0; c < cn; ++c) {
+        const float x = interleaved[base + static_cast<size_t>(c)];
+        const float delayed = line_.read(c, delay);
 
         // feedback: skriv tillbaka input + delayed*fb
-        line[w] = x + delayed * fb;
+        const float fed = x + delayed * fb;
+        line_.write(c, fed);
+        peak = std::max(peak, std::fabs(fed));
 
         // mix
         interleaved[base + static_cast<size_t>(c)] = dry * x + wet * delayed;
-
-        // advance
-        w = (w + 1) % delayLineLen_;
       }
+      line_.advance();
     }
+    delay_ = delay;
+    return peak;
   }
 
-  float maxDelayMs() const noexcept {
-    return (static_cast<float>(delayLineLen_ - 1) /
-            static_cast<float>(sampleRate_)) *
-           1000.0f;
-  }
-
-private:
+  float maxDelayMsConfig_{2000.0f};
   int sampleRate_{44100};
   int maxChannels_{2};
 
-  size_t delayLineLen_{1};
-  std::vector<float> delayLines_;
-  std::vector<size_t> writeIdx_;
+  size_t maxDelaySamples_{1};
+  delay_line line_;
+  // Aktuell fördröjning i sampel, glider mot delayMs_
+  float delay_{1.0f};
+  float glide_{1.0f};
+  bool delaySet_{false};
+  size_t quietFrames_{0};
 
   std::atomic<float> delayMs_{350.0f};
   std::atomic<float> feedback_{0.35f};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace dsp {
+
+// Under denna nivå (-120 dBFS) räknas signal och effektsvansar som tysta.
+inline constexpr float silence_threshold = 1.0e-6f;
+
+// Största |x| i bufferten som bitmönster. För icke-negativa float har
+// bitmönstren samma ordning som värdena, så reduktionen görs med heltal
+// (maska teckenbiten, max) och vektoriseras utan -ffast-math. NaN ger ett
+// större mönster än inf och räknas alltså aldrig som tystnad.
+inline uint32_t max_abs_bits(const float *buf, size_t n) noexcept {
+  uint32_t m = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t b;
+    std::memcpy(&b, buf + i, sizeof(b));
+    b &= 0x7fffffffu;
+    m = b > m ? b : m;
+  }
+  return m;
+}
+
+inline bool is_silent(const float *buf, size_t n,
+                      float threshold = silence_threshold) noexcept {
+  return max_abs_bits(buf, n) < std::bit_cast<uint32_t>(threshold);
+}
+
+} // namespace dsp
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+// Kontroll av realtidssäkerhet i ljudvägen (debugläge).
+//
+// Trådar markeras som realtid med realtime_scope. Byggs projektet med
+// -DSPEAKER_RT_CHECK=ON fångas malloc/free, operator new/delete och
+// pthread_mutex_lock; anrop från en markerad tråd räknas och skrivs ut med
+// stackspår på stderr. SPEAKER_RT_CHECK_ABORT=1 avbryter vid första.
+//
+// Utan flaggan är allt tomma inline-funktioner.
+
+namespace rt_check {
+
+#ifdef SPEAKER_RT_CHECK
+void enter() noexcept;
+void leave() noexcept;
+// Antal fångade anrop från realtidstrådar sedan start
+size_t violations() noexcept;
+#else
+inline void enter() noexcept {}
+inline void leave() noexcept {}
+inline size_t violations() noexcept { return 0; }
+#endif
+
+class realtime_scope {
+public:
+  realtime_scope() noexcept { enter(); }
+  ~realtime_scope() { leave(); }
+
+  realtime_scope(const realtime_scope &) = delete;
+  realtime_scope &operator=(const realtime_scope &) = delete;
+};
+
+} // namespace rt_check
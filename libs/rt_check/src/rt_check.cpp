@@ -0,0 +1,187 @@
+#include "rt_check/rt_check.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Kräver glibc: allokeringarna går vidare till __libc_*, så att ingen dlsym
+// (som själv allokerar) behövs för dem.
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void *__libc_memalign(size_t, size_t);
+void __libc_free(void *);
+}
+
+namespace rt_check {
+namespace {
+
+// Trivialt initierade => ingen TLS-init som i sig kan allokera
+thread_local int rt_depth = 0;
+thread_local bool reporting = false;
+
+using mutex_lock_fn = int (*)(pthread_mutex_t *);
+
+std::atomic<size_t> violation_count{0};
+std::atomic<mutex_lock_fn> real_mutex_lock{nullptr};
+bool abort_on_violation = false;
+
+void report(const char *what) noexcept {
+  if (rt_depth == 0 || reporting)
+    return;
+  reporting = true;
+
+  violation_count.fetch_add(1, std::memory_order_relaxed);
+
+  char msg[128];
+  const int n = std::snprintf(msg, sizeof(msg),
+                              "rt_check: %s i realtidstråd\n", what);
+  if (n > 0)
+    (void)!::write(STDERR_FILENO, msg, static_cast<size_t>(n));
+
+  void *frames[32];
+  const int depth = ::backtrace(frames, 32);
+  // hoppa över report() och den fångade funktionen
+  if (depth > 2)
+    ::backtrace_symbols_fd(frames + 2, depth - 2, STDERR_FILENO);
+
+  if (abort_on_violation)
+    std::abort();
+  reporting = false;
+}
+
+mutex_lock_fn resolve_mutex_lock() noexcept {
+  mutex_lock_fn fn = real_mutex_lock.load(std::memory_order_acquire);
+  if (!fn) {
+    fn = reinterpret_cast<mutex_lock_fn>(
+        ::dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    real_mutex_lock.store(fn, std::memory_order_release);
+  }
+  return fn;
+}
+
+// backtrace() laddar libgcc_s och allokerar första gången; gör det här
+// i stället för vid första överträdelsen. Samma för dlsym.
+struct init {
+  init() {
+    resolve_mutex_lock();
+    void *frames[1];
+    ::backtrace(frames, 1);
+    const char *env = std::getenv("SPEAKER_RT_CHECK_ABORT");
+    abort_on_violation = env && env[0] == '1';
+  }
+} init_once;
+
+} // namespace
+
+void enter() noexcept { ++rt_depth; }
+void leave() noexcept { --rt_depth; }
+
+size_t violations() noexcept {
+  return violation_count.load(std::memory_order_relaxed);
+}
+
+} // namespace rt_check
+
+extern "C" {
+
+void *malloc(size_t n) {
+  rt_check::report("malloc");
+  return __libc_malloc(n);
+}
+
+void *calloc(size_t count, size_t n) {
+  rt_check::report("calloc");
+  return __libc_calloc(count, n);
+}
+
+void *realloc(void *p, size_t n) {
+  rt_check::report("realloc");
+  return __libc_realloc(p, n);
+}
+
+void free(void *p) {
+  if (p)
+    rt_check::report("free");
+  __libc_free(p);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *m) {
+  rt_check::report("pthread_mutex_lock");
+  return rt_check::resolve_mutex_lock()(m);
+}
+
+} // extern "C"
+
+// operator new/delete ersätts också, så att anropet syns som new och inte
+// som den malloc som libstdc++ gör internt.
+namespace {
+
+void *checked_new(size_t n, const char *what) {
+  rt_check::report(what);
+  void *p = __libc_malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *checked_new_aligned(size_t n, std::align_val_t al) {
+  rt_check::report("operator new");
+  void *p = __libc_memalign(static_cast<size_t>(al), n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void checked_delete(void *p) noexcept {
+  if (p)
+    rt_check::report("operator delete");
+  __libc_free(p);
+}
+
+} // namespace
+
+void *operator new(size_t n) { return checked_new(n, "operator new"); }
+void *operator new[](size_t n) { return checked_new(n, "operator new[]"); }
+void *operator new(size_t n, const std::nothrow_t &) noexcept {
+  try {
+    return checked_new(n, "operator new");
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](size_t n, const std::nothrow_t &) noexcept {
+  try {
+    return checked_new(n, "operator new[]");
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new(size_t n, std::align_val_t al) {
+  return checked_new_aligned(n, al);
+}
+void *operator new[](size_t n, std::align_val_t al) {
+  return checked_new_aligned(n, al);
+}
+
+void operator delete(void *p) noexcept { checked_delete(p); }
+void operator delete[](void *p) noexcept { checked_delete(p); }
+void operator delete(void *p, size_t) noexcept { checked_delete(p); }
+void operator delete[](void *p, size_t) noexcept { checked_delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { checked_delete(p); }
+void operator delete[](void *p, std::align_val_t) noexcept {
+  checked_delete(p);
+}
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  checked_delete(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  checked_delete(p);
+}
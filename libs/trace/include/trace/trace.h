@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Spårning av vad ljudtrådarna gör, exporteras som Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev).
+//
+// Varje tråd skriver till en egen ringbuffert utan lås; läsaren kopierar ut
+// händelserna medan trådarna fortsätter. Inspelningen är avslagen tills
+// start() anropas (GET /trace?seconds=N eller --trace). Avslagen kostar en
+// scope en atomisk läsning. Byggs projektet med -DSPEAKER_TRACE=OFF är allt
+// tomma inline-funktioner.
+//
+// Händelsenamn sparas som pekare och måste leva lika länge som processen
+// (strängliteraler eller intern()).
+
+namespace trace {
+
+#ifdef SPEAKER_TRACE
+inline constexpr bool compiled_in = true;
+
+namespace detail {
+extern std::atomic<int> active;
+}
+
+inline bool enabled() noexcept {
+  return detail::active.load(std::memory_order_relaxed) > 0;
+}
+
+uint64_t now_ns() noexcept;
+
+// Namnger anropande tråd och allokerar dess buffert. Anropas innan tråden
+// går in i realtid; andra trådar får en buffert vid första händelsen.
+void register_thread(const char *name);
+
+// För trådar som någon annan skapar (PortAudios callback-tråd):
+// reserve_thread() allokerar bufferten i förväg utanför realtid och
+// attach_thread() i tråden allokerar inget. Trådar som avlöser varandra,
+// t.ex. en ny callback-tråd efter omstart, delar reservationen. -1 => ingen.
+int reserve_thread(const char *name);
+void attach_thread(int slot) noexcept;
+
+void complete(const char *name, uint64_t start_ns, uint64_t end_ns) noexcept;
+void instant(const char *name) noexcept;
+
+// Inspelningen är på så länge minst en start() saknar sin stop()
+void start() noexcept;
+void stop() noexcept;
+
+// Stabil kopia av ett dynamiskt namn, inte för realtidstrådar
+const char *intern(const std::string &name);
+
+// Händelser som började i [from_ns, to_ns) från alla trådar
+std::string chrome_json(uint64_t from_ns, uint64_t to_ns);
+
+// Skriver allt som finns i buffertarna till path när signalen kommer.
+// Filen skrivs av en egen tråd, inte i signalhanteraren.
+void dump_on_signal(int sig, const std::string &path);
+#else
+inline constexpr bool compiled_in = false;
+
+inline bool enabled() noexcept { return false; }
+inline uint64_t now_ns() noexcept { return 0; }
+inline void register_thread(const char *) {}
+inline int reserve_thread(const char *) { return -1; }
+inline void attach_thread(int) noexcept {}
+inline void complete(const char *, uint64_t, uint64_t) noexcept {}
+inline void instant(const char *) noexcept {}
+inline void start() noexcept {}
+inline void stop() noexcept {}
+inline const char *intern(const std::string &) { return ""; }
+inline std::string chrome_json(uint64_t, uint64_t) { return {}; }
+inline void dump_on_signal(int, const std::string &) {}
+#endif
+
+// Mäter tiden från konstruktion till destruktion som en händelse
+class scope {
+public:
+  explicit scope(const char *name) noexcept {
+    if (enabled()) {
+      name_ = name;
+      start_ = now_ns();
+    }
+  }
+  ~scope() {
+    if (name_)
+      complete(name_, start_, now_ns());
+  }
+
+  scope(const scope &) = delete;
+  scope &operator=(const scope &) = delete;
+
+private:
+  const char *name_ = nullptr;
+  uint64_t start_ = 0;
+};
+
+} // namespace trace
@@ -0,0 +1,270 @@
+#include "trace/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace trace {
+
+namespace detail {
+std::atomic<int> active{0};
+}
+
+namespace {
+
+// dsp-tråden skriver några hundra händelser per sekund => knappt en minut
+constexpr uint64_t capacity = 1u << 15;
+constexpr size_t max_threads = 64;
+constexpr uint64_t instant_marker = ~uint64_t{0};
+
+// Fälten är atomiska så att läsaren kan kopiera medan tråden skriver; en
+// kopia som kan ha skrivits över under läsningen kastas efteråt.
+struct event {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> start_ns{0};
+  std::atomic<uint64_t> dur_ns{0};
+};
+
+struct thread_buffer {
+  std::string name;
+  std::atomic<uint64_t> head{0}; // antal skrivna händelser
+  event events[capacity];
+};
+
+std::atomic<thread_buffer *> threads[max_threads];
+std::atomic<size_t> thread_count{0};
+
+// Trivialt initierade => ingen TLS-init i ljudtrådarna
+thread_local thread_buffer *tl_buffer = nullptr;
+thread_local bool tl_registered = false;
+
+// Index i threads, -1 när platserna är slut
+int allocate(const char *name) noexcept {
+  const size_t idx = thread_count.fetch_add(1, std::memory_order_relaxed);
+  if (idx >= max_threads)
+    return -1;
+
+  auto *b = new (std::nothrow) thread_buffer();
+  if (!b)
+    return -1;
+  try {
+    b->name = name;
+  } catch (...) {
+  }
+  threads[idx].store(b, std::memory_order_release);
+  return static_cast<int>(idx);
+}
+
+thread_buffer *claim(const char *name) noexcept {
+  tl_registered = true;
+  const int idx = allocate(name);
+  if (idx < 0)
+    return nullptr;
+  tl_buffer = threads[idx].load(std::memory_order_relaxed);
+  return tl_buffer;
+}
+
+void record(const char *name, uint64_t start, uint64_t dur) noexcept {
+  thread_buffer *b = tl_buffer;
+  if (!b) {
+    if (tl_registered)
+      return;
+    b = claim("thread");
+    if (!b)
+      return;
+  }
+
+  const uint64_t h = b->head.load(std::memory_order_relaxed);
+  event &e = b->events[h & (capacity - 1)];
+  e.name.store(name, std::memory_order_relaxed);
+  e.start_ns.store(start, std::memory_order_relaxed);
+  e.dur_ns.store(dur, std::memory_order_relaxed);
+  b->head.store(h + 1, std::memory_order_release);
+}
+
+struct copied_event {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t dur_ns;
+};
+
+std::vector<copied_event> copy_events(const thread_buffer &b) {
+  const uint64_t h1 = b.head.load(std::memory_order_acquire);
+  const uint64_t lo = h1 > capacity ? h1 - capacity : 0;
+
+  std::vector<copied_event> out;
+  out.reserve(static_cast<size_t>(h1 - lo));
+  for (uint64_t i = lo; i < h1; ++i) {
+    const event &e = b.events[i & (capacity - 1)];
+    out.push_back({e.name.load(std::memory_order_relaxed),
+                   e.start_ns.load(std::memory_order_relaxed),
+                   e.dur_ns.load(std::memory_order_relaxed)});
+  }
+
+  // det som skrivits under kopieringen kan ha ersatt de äldsta, och
+  // record() kan hålla på att skriva h2, som delar plats med h2 - capacity
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t h2 = b.head.load(std::memory_order_relaxed);
+  const uint64_t valid_lo = h2 + 1 > capacity ? h2 + 1 - capacity : 0;
+  if (valid_lo > lo)
+    out.erase(out.begin(),
+              out.begin() + static_cast<std::ptrdiff_t>(
+                                std::min(valid_lo - lo, h1 - lo)));
+  return out;
+}
+
+void append_escaped(std::string &out, const char *s) {
+  for (; *s; ++s) {
+    const char c = *s;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out += ' ';
+    } else {
+      out += c;
+    }
+  }
+}
+
+void append_us(std::string &out, uint64_t ns) {
+  char num[32];
+  std::snprintf(num, sizeof(num), "%.3f", static_cast<double>(ns) / 1000.0);
+  out += num;
+}
+
+int signal_pipe[2] = {-1, -1};
+
+void on_signal(int) {
+  const char c = 1;
+  (void)!::write(signal_pipe[1], &c, 1);
+}
+
+} // namespace
+
+uint64_t now_ns() noexcept {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void register_thread(const char *name) {
+  if (tl_registered)
+    return;
+  claim(name);
+}
+
+int reserve_thread(const char *name) { return allocate(name); }
+
+void attach_thread(int slot) noexcept {
+  tl_registered = true;
+  if (slot >= 0 && static_cast<size_t>(slot) < max_threads)
+    tl_buffer = threads[slot].load(std::memory_order_acquire);
+}
+
+void complete(const char *name, uint64_t start_ns, uint64_t end_ns) noexcept {
+  record(name, start_ns, end_ns > start_ns ? end_ns - start_ns : 0);
+}
+
+void instant(const char *name) noexcept {
+  if (enabled())
+    record(name, now_ns(), instant_marker);
+}
+
+void start() noexcept { detail::active.fetch_add(1, std::memory_order_relaxed); }
+
+void stop() noexcept { detail::active.fetch_sub(1, std::memory_order_relaxed); }
+
+const char *intern(const std::string &name) {
+  static std::mutex m;
+  static std::set<std::string> names;
+  std::lock_guard<std::mutex> lock(m);
+  return names.insert(name).first->c_str();
+}
+
+std::string chrome_json(uint64_t from_ns, uint64_t to_ns) {
+  const int pid = static_cast<int>(::getpid());
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto begin_event = [&] {
+    if (!first)
+      out += ",\n";
+    first = false;
+  };
+
+  const size_t n = std::min(thread_count.load(std::memory_order_relaxed),
+                            max_threads);
+  for (size_t tid = 0; tid < n; ++tid) {
+    const thread_buffer *b = threads[tid].load(std::memory_order_acquire);
+    if (!b)
+      continue;
+
+    begin_event();
+    out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" +
+           std::to_string(pid) + ",\"tid\":" + std::to_string(tid) +
+           ",\"args\":{\"name\":\"";
+    append_escaped(out, b->name.c_str());
+    out += "\"}}";
+
+    for (const copied_event &e : copy_events(*b)) {
+      if (!e.name || e.start_ns < from_ns || e.start_ns >= to_ns)
+        continue;
+      begin_event();
+      out += "{\"name\":\"";
+      append_escaped(out, e.name);
+      out += "\",\"pid\":" + std::to_string(pid) +
+             ",\"tid\":" + std::to_string(tid) + ",\"ts\":";
+      append_us(out, e.start_ns - from_ns);
+      if (e.dur_ns == instant_marker) {
+        out += ",\"ph\":\"i\",\"s\":\"t\"}";
+      } else {
+        out += ",\"ph\":\"X\",\"dur\":";
+        append_us(out, e.dur_ns);
+        out += "}";
+      }
+    }
+  }
+
+  out += "]}\n";
+  return out;
+}
+
+void dump_on_signal(int sig, const std::string &path) {
+  if (signal_pipe[0] >= 0 || ::pipe(signal_pipe) != 0)
+    return;
+
+  std::thread([path] {
+    char c;
+    while (::read(signal_pipe[0], &c, 1) > 0) {
+      const std::string tmp = path + ".tmp";
+      {
+        std::ofstream f(tmp, std::ios::trunc);
+        f << chrome_json(0, ~uint64_t{0});
+      }
+      if (std::rename(tmp.c_str(), path.c_str()) == 0)
+        std::cerr << "trace: " << path << "\n";
+      else
+        std::cerr << "trace: cannot write " << path << "\n";
+    }
+  }).detach();
+
+  struct sigaction sa{};
+  sa.sa_handler = on_signal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  ::sigaction(sig, &sa, nullptr);
+}
+
+} // namespace trace
@@ -1,14 +1,34 @@
 #!/usr/bin/env bash
 
-# Exempel: du måste själv sätta NAME baserat på den data librespot skickar.
-# Om du får JSON på stdin:
-# NAME=$(cat | jq -r '.common_metadata_fields.name')
+# Anropas av librespot --onevent. librespot sätter bl.a. PLAYER_EVENT, NAME,
+# ARTISTS, DURATION_MS, POSITION_MS och VOLUME som env-variabler.
+#
+# Händelsen skrivs som en rad till speaker-processens FIFO med bara
+# bash-inbyggda kommandon: ingen curl, ingen TCP-anslutning.
 
-# Om du får env-variabler:
-# NAME="$TRACK_NAME"
+FIFO="${SPEAKER_EVENT_FIFO:-/tmp/speaker-events}"
 
-if [ -z "$NAME" ]; then
-  exit 0
-fi
+# speaker körs inte => inget att göra
+[ -p "$FIFO" ] || exit 0
 
-curl -s -X POST "http://localhost:8080/now_playing?name=${NAME}" >/dev/null
+# tab och radbrytning är fältavgränsare i formatet. Bara parameter-
+# expansion, command substitution skulle forka en subshell.
+TAB=$'\t'
+NL=$'\n'
+name="${NAME//$TAB/ }"
+name="${name//$NL/ }"
+# ARTISTS är en radseparerad lista
+artist="${ARTISTS//$TAB/ }"
+artist="${artist//$NL/, }"
+
+line="event=${PLAYER_EVENT}"
+[ -n "$name" ] && line+="${TAB}name=${name}"
+[ -n "$artist" ] && line+="${TAB}artist=${artist}"
+[ -n "$DURATION_MS" ] && line+="${TAB}duration_ms=${DURATION_MS}"
+[ -n "$POSITION_MS" ] && line+="${TAB}position_ms=${POSITION_MS}"
+[ -n "$VOLUME" ] && line+="${TAB}volume=${VOLUME}"
+
+# <> öppnar utan att blockera i väntan på läsare
+exec 3<>"$FIFO" || exit 0
+printf '%s\n' "$line" >&3
+exec 3>&-